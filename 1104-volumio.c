@@ -1,6 +1,12 @@
 // sudo apt install -y libgpiod-dev libcjson-dev libcurl4-openssl-dev
-// gcc -Wall -Wextra -O2 -o 1104-volumio 1104-volumio.c -lgpiod -lcurl -lcjson -lrt (-lrt for older system)
+// gcc -Wall -Wextra -O2 -o 1104-volumio 1104-volumio.c volumio_http.c i2c_transport.c keymap.c -lgpiod -lcurl -lcjson -lpthread -lrt (-lrt for older system)
 // gpioinfo gpiochip0
+// ./1104-volumio [-d /dev/i2c-N] [-a address] [-u volumio_url] [ir_section]    or    ./1104-volumio --stats for MCU interrupt load
+// ./1104-volumio -m frames.txt [ir_section]    replays frames recorded by mcu-sim -w, no MCU or GPIO needed
+// ir_section defaults to "all": every IR section at once, each matching the protocol Config "protocols" gives it
+// ./1104-volumio --compile    rebuilds myir.keymap.bin from myir.keymap.json; any start with a stale one does too
+// Edits to myir.keymap.json apply while running. To switch the IR section:
+// echo "section RMT-AH103U" | socat - UNIX-SENDTO:/tmp/1104-volumio.sock    (also "reload", "status")
 
 #define _POSIX_C_SOURCE 200809L
 #include <stdio.h>
@@ -9,74 +15,345 @@
 #include <string.h>
 #include <unistd.h>
 #include <stdbool.h>
-#include <fcntl.h>
+#include <errno.h>
 #include <sys/stat.h>
-#include <sys/ioctl.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
 #include <signal.h>
-#include <linux/i2c-dev.h>
-#include <linux/i2c.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
 #include <gpiod.h>
 #include <time.h>
+#include <getopt.h>
 #include <cjson/cJSON.h>
 #include "keycode_lookup.h"
+#include "i2c_regmap.h"
+#include "i2c_transport.h"
+#include "keymap.h"
+#include "ir_decoder.h"
+#include "volumio_http.h"
 #include <curl/curl.h>
 #include <syslog.h>
 
-#define MAX_KEYS 64
-#define MAX_BUTTONS 64
 #define KEYMAP_FILE "myir.keymap.json"
+#define KEYMAP_CACHE "myir.keymap.bin"	// KEYMAP_FILE compiled, rebuilt when stale
+#define KEYMAP_ALL "all"		// ir_section: every IR section merged, routed by protocol
+#define CONTROL_SOCKET "/tmp/1104-volumio.sock"	// datagrams: "section <name>", "reload", "status"
+#define RELOAD_SETTLE_MS 100		// editors write in steps, reload once they are done
 #define INITIAL_DELAY 500		// ms for volume delay
 #define MINIMUM_DELAY 100		// ms for volume delay
 #define DECAY .85			// for volume delay
 #define KEY_REPEAT_DELAY_MS 1000	// for number keys
+#define TICKS_PER_MS 500		// capture stamp runs at 2 us
+#define ROTARY_STEP 2			// volume % per detent
+#define VOLUME_RESYNC_MS 2000		// re-read Volumio volume after knob idle
+#define GPIO_IRQ 4			// MCU event line, active low
+#define GPIO_SDA 2
+#define GPIO_SCL 3
+#define QUEUE_DEPTH 16			// commands waiting for Volumio, Config "queue_depth"
+#define QUEUE_DEPTH_MAX 256
+#define COMMAND_LEN 128
+#define SLOW_COMMAND_MS 250		// log commands that took longer from input to reply
+#define VOLUME_INTERVAL_MS 50		// at most one volume command per interval, the rest is merged
+#define POWEROFF_COMMAND "poweroff"	// keymap command run here instead of sent to Volumio
+
+uint8_t i2c_data[8];			// Event being processed, 8 bytes
+uint8_t i2c_frame[FRAME_SIZE];		// Header + up to EVT_BURST events
+uint32_t event_stamp;			// MCU capture time of i2c_data, 2 us ticks
+uint16_t event_hold;			// ms the key of i2c_data has been held, 0 on PRESS and TAP
+uint8_t event_proto;			// IR_PROTO_* of i2c_data, IR_PROTO_NONE for buttons
+const char *action_names[ACT_COUNT] = {		// keymap entry fields, one command per gesture
+    [ACT_PRESS] = "keycommand", [ACT_REPEAT] = "repeat", [ACT_LONG] = "long",
+    [ACT_RELEASE] = "release", [ACT_TAP2] = "tap2", [ACT_TAP3] = "tap3",
+};
+volatile sig_atomic_t running = 1;
 
-uint8_t i2c_data[8];			// Buffer to store 8 bytes
 typedef struct {
-    uint32_t scancode;
-    uint16_t keycode;
-    char *keycommand;
-} keymap_t;
+    keymap_t ir, btn;				// IR keys by scancode, buttons by pin bits
+    keymap_cache_t cache;			// image ir and btn point into, if current
+    cJSON *config;				// "Config" object of KEYMAP_FILE
+    char section[KEYMAP_NAME_MAX];		// IR section in ir
+    uint32_t generation;
+} keymaps_t;
 
-volatile sig_atomic_t running = 1;
-keymap_t ir_table[MAX_KEYS + 1];
-keymap_t btn_table[MAX_BUTTONS + 1];
-int ir_keycount = 0, btn_keycount = 0;
+// Built whole by the reload thread, then published with one atomic store: the main loop
+// loads the pointer per event and never sees a half-built table. A replaced set is freed
+// once the main loop has started another pass, when nothing can still point into it.
+_Atomic(keymaps_t *) keymaps;
+atomic_uint keymaps_epoch;			// main loop passes
 uint16_t delay = INITIAL_DELAY;
 struct gpiod_line_event event;
 struct gpiod_line *line;
 struct gpiod_chip *chip;
 
 timer_t debounce_timer;
+bool debounce_armed = false;		// digit timer running, polled by the main loop
 uint8_t press_count = 0;
 uint16_t track_number = 0;
+uint32_t overflow_count = 0;		// frames reporting dropped MCU events
+uint32_t torn_count = 0;		// frames failing the CRC check
+uint32_t missed_count = 0;		// frames lost between reads, from sequence gaps
+int frame_seq = -1;			// sequence number of the last good frame
+const char *ir_proto_names[IR_PROTO_COUNT] = {
+    [IR_PROTO_RC5] = "RC5", [IR_PROTO_SIRC] = "SIRC", [IR_PROTO_NEC] = "NEC",
+    [IR_PROTO_RC6] = "RC6", [IR_PROTO_SAMSUNG] = "SAMSUNG", [IR_PROTO_JVC] = "JVC",
+};
+int volume = -1;			// locally tracked Volumio volume, -1 unknown, worker thread only
+
+enum { QUEUE_DROP, QUEUE_WAIT };	// full queue: drop the new command, or wait for a free slot
+const char *queue_policy_names[] = { [QUEUE_DROP] = "drop", [QUEUE_WAIT] = "wait" };
+
+typedef struct {
+    char cmd[COMMAND_LEN];		// empty: volume change by delta detents
+    int8_t delta;
+    struct timespec queued;
+} command_t;
+
+// Commands reach Volumio from a worker thread, so a slow Volumio never holds up GPIO4
+// and the I2C reads. One producer (main loop) and one consumer (worker): head and tail
+// each have a single writer, no locks.
+struct {
+    command_t *slot;
+    uint32_t depth;
+    int policy;
+    _Atomic uint32_t head, tail;	// next slot to fill / to send
+    atomic_bool stop;
+    sem_t ready;			// one post per queued command
+    pthread_t worker;
+    uint32_t dropped;			// main loop only
+    uint32_t sent, failed;		// worker only, like the times
+    uint32_t merged, superseded;	// volume steps folded into one command, commands made pointless
+    uint64_t wait_us, total_us, max_us;
+} queue = { .depth = QUEUE_DEPTH, .policy = QUEUE_DROP };
+
+int send_volume_delta(int delta);
+
+int send_volumio_command(const char *cmd) {
+    if (!strncmp(cmd, "volume&volume=", 14) && cmd[14] >= '0' && cmd[14] <= '9')
+        volume = atoi(cmd + 14);			// deltas continue from here
+    return volumio_command(cmd);			// kept-alive connection, see volumio_http.c
+}
+
+enum { KIND_OTHER, KIND_VOLUME, KIND_TRACK, KIND_SEEK };
+
+// What a command changes, and whether it sets an absolute target. Relative volume
+// commands report their step in detents, like the knob's entries.
+int command_kind(const command_t *c, bool *absolute, int *step) {
+    const char *cmd = c->cmd;
+
+    *absolute = false;
+    *step = 0;
+    if (!cmd[0]) {
+        *step = c->delta;
+        return KIND_VOLUME;
+    }
+    if (!strncmp(cmd, "volume&volume=", 14)) {
+        *absolute = cmd[14] >= '0' && cmd[14] <= '9';
+        *step = !strcmp(cmd + 14, "plus") ? 1 : !strcmp(cmd + 14, "minus") ? -1 : 0;
+        return *absolute || *step ? KIND_VOLUME : KIND_OTHER;
+    }
+    if (!strncmp(cmd, "play&N=", 7) || !strncmp(cmd, "playplaylist&", 13)) {
+        *absolute = true;
+        return KIND_TRACK;
+    }
+    if (!strcmp(cmd, "next") || !strcmp(cmd, "prev"))
+        return KIND_TRACK;
+    if (!strncmp(cmd, "seek&position=", 14)) {
+        *absolute = cmd[14] >= '0' && cmd[14] <= '9';
+        return KIND_SEEK;
+    }
+    return KIND_OTHER;
+}
+
+// A queued command setting an absolute target of the same kind makes c pointless
+static bool superseded(uint32_t index, uint32_t head) {
+    bool absolute;
+    int step, kind = command_kind(&queue.slot[index % queue.depth], &absolute, &step);
+
+    for (uint32_t i = index + 1; kind != KIND_OTHER && i != head; i++) {
+        if (command_kind(&queue.slot[i % queue.depth], &absolute, &step) == kind && absolute)
+            return true;
+    }
+    return false;
+}
+
+static uint64_t us_between(const struct timespec *a, const struct timespec *b) {
+    return (b->tv_sec - a->tv_sec) * 1000000LL + (b->tv_nsec - a->tv_nsec) / 1000;
+}
+
+void *queue_worker(void *arg) {
+    (void)arg;
+    while (!atomic_load(&queue.stop)) {
+        if (sem_wait(&queue.ready) < 0)
+            continue;					// EINTR
+        uint32_t tail = atomic_load_explicit(&queue.tail, memory_order_relaxed);
+        if (atomic_load(&queue.stop) || tail == atomic_load_explicit(&queue.head, memory_order_acquire))
+            continue;					// woken by queue_stop()
+
+        command_t *c = &queue.slot[tail % queue.depth];
+        uint32_t head = atomic_load_explicit(&queue.head, memory_order_acquire), used = 1;
+        if (superseded(tail, head)) {
+            queue.superseded++;
+            atomic_store_explicit(&queue.tail, tail + 1, memory_order_release);
+            continue;
+        }
+
+        static struct timespec last_volume;
+        struct timespec start, done;
+        bool absolute;
+        int step, ret;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        if (command_kind(c, &absolute, &step) == KIND_VOLUME && step) {
+            uint64_t since = us_between(&last_volume, &start);
+            if (since < VOLUME_INTERVAL_MS * 1000) {	// let more steps arrive, then send them as one
+                struct timespec pause = { 0, (VOLUME_INTERVAL_MS * 1000 - since) * 1000 };
+                nanosleep(&pause, NULL);
+                clock_gettime(CLOCK_MONOTONIC, &start);
+                head = atomic_load_explicit(&queue.head, memory_order_acquire);
+            }
+            int delta = step;
+            while (tail + used != head && command_kind(&queue.slot[(tail + used) % queue.depth], &absolute, &step)
+                   == KIND_VOLUME && step) {
+                delta += step;
+                used++;
+            }
+            queue.merged += used - 1;
+            ret = send_volume_delta(delta);
+            clock_gettime(CLOCK_MONOTONIC, &last_volume);
+        } else ret = send_volumio_command(c->cmd);
+        clock_gettime(CLOCK_MONOTONIC, &done);
+
+        uint64_t wait = us_between(&c->queued, &start), total = us_between(&c->queued, &done);
+        if (ret < 0) queue.failed++;
+        else queue.sent++;
+        queue.wait_us += wait;
+        queue.total_us += total;
+        if (total > queue.max_us) queue.max_us = total;
+        if (total > SLOW_COMMAND_MS * 1000)
+            fprintf(stderr, "%s took %llu ms, %llu ms of it queued\n", c->cmd[0] ? c->cmd : "volume change",
+                (unsigned long long)total / 1000, (unsigned long long)wait / 1000);
+        atomic_store_explicit(&queue.tail, tail + used, memory_order_release);   // their posts find it empty
+    }
+    return NULL;
+}
+
+// Main loop only. Returns false if the command was dropped
+bool queue_push(const char *cmd, int8_t delta) {
+    uint32_t head = atomic_load_explicit(&queue.head, memory_order_relaxed);
 
-void send_volumio_command(const char *cmd) {
+    while (head - atomic_load_explicit(&queue.tail, memory_order_acquire) >= queue.depth) {
+        if (queue.policy == QUEUE_DROP || !running) {
+            queue.dropped++;
+            fprintf(stderr, "Command queue full, %s dropped\n", cmd ? cmd : "volume change");
+            return false;
+        }
+        nanosleep(&(struct timespec){0, 1000000}, NULL);
+    }
+    command_t *c = &queue.slot[head % queue.depth];
+    snprintf(c->cmd, sizeof(c->cmd), "%s", cmd ? cmd : "");
+    c->delta = delta;
+    clock_gettime(CLOCK_MONOTONIC, &c->queued);
+    atomic_store_explicit(&queue.head, head + 1, memory_order_release);
+    sem_post(&queue.ready);
+    return true;
+}
+
+void queue_command(const char *cmd) {
     if (!cmd || !*cmd) {
         // Nothing to send; avoid crash
-        fprintf(stderr, "send_volumio_command: NULL or empty command ignored\n");
+        fprintf(stderr, "queue_command: NULL or empty command ignored\n");
         return;
     }
+    if (!strcmp(cmd, POWEROFF_COMMAND)) {
+        system("/sbin/poweroff");
+        return;
+    }
+    queue_push(cmd, 0);
+}
 
-    CURL *curl = curl_easy_init();
-    if (curl) {
-        char url[256];
-        snprintf(url, sizeof(url),
-                 "http://localhost:3000/api/v1/commands/?cmd=%s", cmd);
-        curl_easy_setopt(curl, CURLOPT_NOBODY, 1L);  // we don't need body
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, NULL);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, NULL);
-        curl_easy_setopt(curl, CURLOPT_VERBOSE, 0L);
-        curl_easy_setopt(curl, CURLOPT_URL, url);
-        curl_easy_setopt(curl, CURLOPT_TIMEOUT, 2L);
-        curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-        CURLcode res = curl_easy_perform(curl);
-        if (res != CURLE_OK) {
-            fprintf(stderr, "curl error: %s\n", curl_easy_strerror(res));
-        }
-        curl_easy_cleanup(curl);
-    } else {
-        fprintf(stderr, "curl_easy_init failed\n");
+int queue_start(void) {
+    queue.slot = calloc(queue.depth, sizeof(command_t));
+    if (!queue.slot || sem_init(&queue.ready, 0, 0) < 0) {
+        perror("command queue");
+        return -1;
+    }
+    errno = pthread_create(&queue.worker, NULL, queue_worker, NULL);
+    if (errno) {
+        perror("pthread_create");
+        return -1;
     }
+    printf("Command queue: %u deep, %s when full\n", queue.depth, queue_policy_names[queue.policy]);
+    return 0;
+}
+
+// Commands still queued are dropped, the one in flight finishes or times out
+void queue_stop(void) {
+    atomic_store(&queue.stop, true);
+    sem_post(&queue.ready);
+    pthread_join(queue.worker, NULL);
+
+    uint32_t n = queue.sent + queue.failed;
+    queue.dropped += atomic_load(&queue.head) - atomic_load(&queue.tail);
+    fprintf(stderr, "Commands: %u sent, %u failed, %u dropped, %u volume steps merged, %u superseded",
+        queue.sent, queue.failed, queue.dropped, queue.merged, queue.superseded);
+    if (n)
+        fprintf(stderr, ", input to reply avg %.1f ms (%.1f ms queued), max %.1f ms",
+            queue.total_us / 1e3 / n, queue.wait_us / 1e3 / n, queue.max_us / 1e3);
+    fprintf(stderr, "\n");
+    sem_destroy(&queue.ready);
+    free(queue.slot);
+}
+
+int get_volumio_volume(void) {
+    int vol = -1;
+    char body[4096];
+
+    if (volumio_get("/api/v1/getState", body, sizeof(body)) < 0)
+        return -1;
+
+    cJSON *root = cJSON_Parse(body);
+    if (root) {
+        cJSON *v = cJSON_GetObjectItem(root, "volume");
+        if (cJSON_IsNumber(v)) vol = v->valueint;
+        cJSON_Delete(root);
+    }
+    return vol;
+}
+
+// Apply all detents from one I2C read as a single absolute volume change, on the worker
+void apply_volume_delta(int8_t delta) {
+    queue_push(NULL, delta);
+}
+
+int send_volume_delta(int delta) {
+    static struct timespec last;
+    struct timespec now;
+    char cmd[64];
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    int64_t idle_ms = (now.tv_sec - last.tv_sec) * 1000LL + (now.tv_nsec - last.tv_nsec) / 1000000;
+    last = now;						// zero on the first call, idle_ms is then huge
+    if (volume < 0 || idle_ms > VOLUME_RESYNC_MS)	// volume may have changed elsewhere
+        volume = get_volumio_volume();
+
+    if (volume < 0) {					// no state, fall back to relative steps, one per detent
+        snprintf(cmd, sizeof(cmd), "volume&volume=%s", delta > 0 ? "plus" : "minus");
+        int ret = 0;
+        for (int i = abs(delta); i > 0 && ret == 0; i--)
+            ret = send_volumio_command(cmd);
+        return ret;
+    }
+    int before = volume;
+    volume += delta * ROTARY_STEP;
+    if (volume > 100) volume = 100;
+    if (volume < 0) volume = 0;
+    if (volume == before)
+        return 0;					// at the end stop, or steps cancelled out
+    snprintf(cmd, sizeof(cmd), "volume&volume=%d", volume);
+    return send_volumio_command(cmd);
 }
 
 void debounce_timeout() {
@@ -86,16 +363,16 @@ void debounce_timeout() {
     fprintf(stderr, "No new press for %d ms, executing action for key %03d (%d %s), %s\n",
         KEY_REPEAT_DELAY_MS, track_number, press_count + 1, press_count ? "presses" : "press", cmd);
 
-    send_volumio_command(cmd);
+    queue_command(cmd);
 
     press_count = 0;      // reset for next series
     track_number = 0;
 }
 
+// No notification: the main loop polls the timer, so the queue keeps a single producer
 void setup_debounce_timer(void) {
     struct sigevent sev = {0};
-    sev.sigev_notify = SIGEV_THREAD;
-    sev.sigev_notify_function = debounce_timeout;
+    sev.sigev_notify = SIGEV_NONE;
     if (timer_create(CLOCK_MONOTONIC, &sev, &debounce_timer) != 0) {
         perror("timer_create");
     }
@@ -105,6 +382,22 @@ void restart_debounce_timer(struct itimerspec its) {
     if (timer_settime(debounce_timer, 0, &its, NULL) != 0) {
         perror("timer_settime");
     }
+    debounce_armed = true;
+}
+
+// Runs debounce_timeout() once the timer expired, else shortens wait to its expiry
+void debounce_poll(struct timespec *wait) {
+    struct itimerspec its;
+
+    if (!debounce_armed || timer_gettime(debounce_timer, &its) != 0)
+        return;
+    if (!its.it_value.tv_sec && !its.it_value.tv_nsec) {
+        debounce_armed = false;
+        debounce_timeout();
+    } else if (its.it_value.tv_sec < wait->tv_sec ||
+               (its.it_value.tv_sec == wait->tv_sec && its.it_value.tv_nsec < wait->tv_nsec)) {
+        *wait = its.it_value;
+    }
 }
 
 int open_gpiod_line(uint8_t gpio)
@@ -144,49 +437,87 @@ int open_gpiod_line(uint8_t gpio)
     return 0;
 }
 
-bool load_keymap_section(const char *filename, const char *section_name, keymap_t *table, int *count, int max_entries) {
+// i2c_unstick hook, runs while the I2C adapter is unbound and its pins are plain GPIOs.
+// A target stopped mid-byte holds SDA low until it has clocked out the rest of it:
+// nine SCL pulses finish any byte and its ACK, then a STOP resets its state machine.
+void unstick_bus(void) {
+    struct gpiod_line *scl = chip ? gpiod_chip_get_line(chip, GPIO_SCL) : NULL;
+    struct gpiod_line *sda = chip ? gpiod_chip_get_line(chip, GPIO_SDA) : NULL;
+    struct timespec half = {0, 5000};			// 100 kHz
+
+    if (!scl || !sda ||
+        gpiod_line_request_output_flags(scl, "i2c_unstick", GPIOD_LINE_REQUEST_FLAG_OPEN_DRAIN, 1) < 0)
+        return;
+    if (gpiod_line_request_output_flags(sda, "i2c_unstick", GPIOD_LINE_REQUEST_FLAG_OPEN_DRAIN, 1) < 0) {
+        gpiod_line_release(scl);
+        return;
+    }
+    for (int i = 0; i < 9; i++) {
+        gpiod_line_set_value(scl, 0);
+        nanosleep(&half, NULL);
+        gpiod_line_set_value(scl, 1);
+        nanosleep(&half, NULL);
+    }
+    gpiod_line_set_value(scl, 0);			// STOP: SDA rises while SCL is high
+    gpiod_line_set_value(sda, 0);
+    nanosleep(&half, NULL);
+    gpiod_line_set_value(scl, 1);
+    nanosleep(&half, NULL);
+    gpiod_line_set_value(sda, 1);
+    nanosleep(&half, NULL);
+    gpiod_line_release(sda);
+    gpiod_line_release(scl);
+}
+
+cJSON *read_json_file(const char *filename) {
     struct stat st;
     if (stat(filename, &st) < 0) {
         perror("stat keymap");
-        return false;
+        return NULL;
     }
     FILE *f = fopen(filename, "r");
     if (!f) {
         perror("fopen keymap");
-        return false;
+        return NULL;
     }
 
     char *json_text = malloc(st.st_size + 1);
     if (!json_text) {
         fclose(f);
-        return false;
+        return NULL;
     }
     size_t got = fread(json_text, 1, st.st_size, f);
         if (got != (size_t)st.st_size) {
             fprintf(stderr, "fread size mismatch: expected %zu got %zu\n", (size_t)st.st_size, got);
             free(json_text);
             fclose(f);
-            return false;
+            return NULL;
         }
     json_text[st.st_size] = '\0';
     fclose(f);
 
     cJSON *root = cJSON_Parse(json_text);
-    if (!root) {
+    if (!root)
         fprintf(stderr, "Failed to parse JSON.\n");
-        free(json_text);
-        return false;
-    }
+    free(json_text);
+    return root;
+}
 
-    cJSON *section = cJSON_GetObjectItem(root, section_name);
-    if (!section || !cJSON_IsArray(section)) {
-        fprintf(stderr, "Section \"%s\" not found or not an array.\n", section_name);
-        cJSON_Delete(root);
-        free(json_text);
-        return false;
+// IR_PROTO_* of a section's remote from Config "protocols", IR_PROTO_NONE matches any
+uint8_t section_protocol(const cJSON *config, const char *section_name) {
+    cJSON *v = cJSON_GetObjectItem(cJSON_GetObjectItem(config, "protocols"), section_name);
+
+    for (int p = 1; p < IR_PROTO_COUNT && cJSON_IsString(v); p++) {
+        if (!strcmp(v->valuestring, ir_proto_names[p]))
+            return p;
     }
+    if (v)
+        fprintf(stderr, "Unknown protocol for section '%s', it matches any\n", section_name);
+    return IR_PROTO_NONE;
+}
 
-    *count = 0;
+// False if memory ran out, the map is then incomplete
+bool load_keymap_section(const cJSON *section, const char *section_name, uint8_t proto, keymap_t *map) {
     cJSON *item;
     cJSON_ArrayForEach(item, section) {
         cJSON *s = cJSON_GetObjectItem(item, "scancode");
@@ -196,35 +527,383 @@ bool load_keymap_section(const char *filename, const char *section_name, keymap_
             uint32_t sc = (uint32_t)strtoul(s->valuestring, NULL, 16);
             uint16_t kc = resolve_keycode(k->valuestring);
             char* vc = v->valuestring;
-            if (kc > 0 && *count < max_entries) {
-                table[(*count)++] = (keymap_t){sc, kc, strdup(vc)};
+            keymap_entry_t *key = NULL;
+            int added = kc > 0 ? keymap_add(map, proto, sc, kc, &key) : 0;
+            if (added < 0)
+                return false;
+            if (added == KEYMAP_DUPLICATE)
+                fprintf(stderr, "Scancode %s repeated in section '%s', first entry %s kept\n", s->valuestring, section_name,
+                    keycode_name(keymap_find(map, proto, sc)->keycode));
+            if (key) {
+                if (keymap_set(map, key, ACT_PRESS, vc) < 0)
+                    return false;
+                for (int a = ACT_PRESS + 1; a < ACT_COUNT; a++) {
+                    cJSON *g = cJSON_GetObjectItem(item, action_names[a]);
+                    if (cJSON_IsString(g) && keymap_set(map, key, a, g->valuestring) < 0)
+                        return false;
+                }
+                if (!keymap_bound(key, ACT_REPEAT) && (kc == 114 || kc == 115 || kc == 103 || kc == 108))
+                    key->action[ACT_REPEAT] = key->action[ACT_PRESS];	// volume and arrows repeat by default
             }
         }
     }
+    return true;
+}
+
+// Every array section of KEYMAP_FILE compiled into KEYMAP_CACHE, plus KEYMAP_ALL, and the
+// sections the daemon uses kept. Parses the JSON once. The cache is written for the next
+// start, a failure to write it only matters for --compile.
+bool load_keymaps_json(keymaps_t *km, const struct stat *st, bool compile) {
+    cJSON *root = read_json_file(KEYMAP_FILE);
+    if (!root)
+        return false;
+
+    const cJSON *config = cJSON_GetObjectItem(root, "Config");
+    int size = cJSON_GetArraySize(root), count = 0;
+    keymap_t *maps = calloc(size + 1, sizeof(*maps));
+    const char **names = calloc(size + 1, sizeof(*names));
+    cJSON *section;
+    if (!maps || !names) {
+        free(maps);
+        free(names);
+        cJSON_Delete(root);
+        return false;
+    }
+    cJSON_ArrayForEach(section, root) {
+        if (!cJSON_IsArray(section))
+            continue;
+        if (strlen(section->string) >= KEYMAP_NAME_MAX) {
+            fprintf(stderr, "Section name \"%s\" is longer than %d characters, skipped\n", section->string,
+                KEYMAP_NAME_MAX - 1);
+            continue;
+        }
+        if (!strcmp(section->string, KEYMAP_ALL)) {
+            fprintf(stderr, "Section name \"%s\" stands for all IR sections, skipped\n", section->string);
+            continue;
+        }
+        bool buttons = !strcmp(section->string, "Button");
+        names[count] = section->string;
+        if (!load_keymap_section(section, section->string,
+                buttons ? IR_PROTO_NONE : section_protocol(config, section->string), &maps[count++]))
+            goto out_of_memory;
+    }
 
-    table[*count] = (keymap_t){0, 0, 0};
+    // One index over every remote: a code is looked up under the protocol that sent it, so
+    // remotes on different protocols never shadow each other
+    for (int i = 0; i < count; i++) {
+        int skipped = strcmp(names[i], "Button") ? keymap_merge(&maps[count], &maps[i]) : 0;
+        if (skipped < 0)
+            goto out_of_memory;
+        if (skipped > 0)
+            fprintf(stderr, "%d codes of section '%s' are in an earlier section, left out of '%s'\n", skipped, names[i],
+                KEYMAP_ALL);
+    }
+    names[count++] = KEYMAP_ALL;
+
+    char *config_text = cJSON_PrintUnformatted(config);
+    bool written = keymap_cache_write(KEYMAP_CACHE, st, names, maps, count, config_text) == 0;
+    if (written)
+        printf("Compiled %d sections of %s into %s\n", count, KEYMAP_FILE, KEYMAP_CACHE);
+    for (int i = 0; i < count; i++) {
+        if (!strcmp(names[i], km->section))
+            km->ir = maps[i];
+        else if (!strcmp(names[i], "Button"))
+            km->btn = maps[i];
+        else
+            keymap_free(&maps[i]);
+    }
+    km->config = config_text ? cJSON_Parse(config_text) : NULL;
+    cJSON_free(config_text);
+    free(maps);
+    free(names);
     cJSON_Delete(root);
-    free(json_text);
-    printf("Loaded %d entries from section '%s'\n", *count, section_name);
-    return *count > 0;
+    return written || !compile;
+
+out_of_memory:						// the keymap would be missing keys, keep the old one
+    fprintf(stderr, "Out of memory loading %s\n", KEYMAP_FILE);
+    for (int i = 0; i <= count; i++)			// merged sections at maps[count]
+        keymap_free(&maps[i]);
+    free(maps);
+    free(names);
+    cJSON_Delete(root);
+    return false;
 }
 
-uint16_t lookup_code(uint32_t code, keymap_t *table, int count) {
-    for (int i = 0; i < count; i++) {
-        if (table[i].scancode == code)
-            return table[i].keycode;
+void keymaps_free(keymaps_t *km) {
+    if (!km)
+        return;
+    keymap_free(&km->ir);
+    keymap_free(&km->btn);
+    keymap_cache_close(&km->cache);
+    cJSON_Delete(km->config);
+    free(km);
+}
+
+// ir_section and "Button", and "Config". From the mapped KEYMAP_CACHE when it was compiled
+// from the current KEYMAP_FILE, without parsing or allocating per entry; else from the
+// JSON, which refreshes the cache for the next start. NULL if neither could be read.
+keymaps_t *keymaps_load(const char *ir_section, bool compile) {
+    static uint32_t generation;
+    struct stat st;
+    keymaps_t *km = calloc(1, sizeof(*km));
+
+    if (!km)
+        return NULL;
+    snprintf(km->section, sizeof(km->section), "%s", ir_section);
+    km->generation = ++generation;
+    if (stat(KEYMAP_FILE, &st) < 0) {
+        perror("stat keymap");
+        free(km);
+        return NULL;
     }
-    return -1;
+    if (!compile && keymap_cache_open(KEYMAP_CACHE, &st, &km->cache) == 0) {
+        keymap_cache_section(&km->cache, ir_section, &km->ir);
+        keymap_cache_section(&km->cache, "Button", &km->btn);
+        const char *config_text = keymap_cache_config(&km->cache);
+        km->config = config_text ? cJSON_Parse(config_text) : NULL;
+    } else if (!load_keymaps_json(km, &st, compile)) {
+        keymaps_free(km);
+        return NULL;
+    }
+    printf("Loaded %u entries from section '%s', %u from 'Button'%s\n", km->ir.count, ir_section, km->btn.count,
+        km->cache.base ? " (cached)" : "");
+    return km;
 }
 
-char* lookup_command(uint32_t code, keymap_t *table, int count) {
-    for (int i = 0; i < count; i++) {
-        if (table[i].scancode == code)
-            return table[i].keycommand;
+// Reload thread
+
+struct {
+    pthread_t thread;
+    int inotify, control;			// watch on KEYMAP_FILE's directory, CONTROL_SOCKET
+    atomic_bool stop;
+    uint32_t reloads, failures;
+} reload = { .inotify = -1, .control = -1 };
+
+// Swap in a complete set, then free the old one after the grace period: a main loop pass
+// that may have loaded the old pointer started before the swap, so it has ended once the
+// epoch moves on. After reload_stop() the main loop is gone and nothing is waited for.
+void keymaps_publish(keymaps_t *next) {
+    keymaps_t *old = atomic_exchange(&keymaps, next);
+    unsigned epoch = atomic_load(&keymaps_epoch);
+
+    while (atomic_load(&keymaps_epoch) == epoch && !atomic_load(&reload.stop)) {
+        struct timespec tick = {0, 10000000};
+        nanosleep(&tick, NULL);
+    }
+    keymaps_free(old);
+}
+
+// A new set for section, published only if it is usable. Key handling carries on with
+// the old set meanwhile, and keeps it when the new one fails.
+bool keymaps_reload(const char *section, char *why, size_t size) {
+    keymaps_t *km = keymaps_load(section, false);
+
+    if (!km || !km->ir.count || !km->btn.count) {
+        snprintf(why, size, "%s", !km ? "keymap unreadable" : !km->ir.count ? "no such IR section" : "no Button section");
+        keymaps_free(km);
+        reload.failures++;
+        return false;
+    }
+    snprintf(why, size, "section '%s', %u keys, %u buttons", km->section, km->ir.count, km->btn.count);
+    keymaps_publish(km);
+    reload.reloads++;
+    return true;
+}
+
+int control_open(void) {
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    int fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+
+    if (fd < 0) {
+        perror("control socket");
+        return -1;
+    }
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", CONTROL_SOCKET);
+    unlink(CONTROL_SOCKET);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("bind control socket");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// One request per datagram, the answer goes back if the sender has an address
+void control_handle(int fd) {
+    char msg[128], reply[160];
+    struct sockaddr_un from;
+    socklen_t len = sizeof(from);
+    ssize_t n = recvfrom(fd, msg, sizeof(msg) - 1, 0, (struct sockaddr *)&from, &len);
+
+    if (n <= 0)
+        return;
+    while (n > 0 && (msg[n - 1] == '\n' || msg[n - 1] == ' ')) n--;
+    msg[n] = '\0';
+
+    const keymaps_t *km = atomic_load(&keymaps);	// only this thread replaces it
+    char why[128];
+    if (!strncmp(msg, "section ", 8) || !strcmp(msg, "reload")) {
+        bool ok = keymaps_reload(msg[0] == 's' ? msg + 8 : km->section, why, sizeof(why));
+        snprintf(reply, sizeof(reply), "%s: %s", ok ? "ok" : "error", why);
+    } else if (!strcmp(msg, "status")) {
+        snprintf(reply, sizeof(reply), "ok: section '%s', %u keys, %u buttons, %u reloads, %u failed%s",
+            km->section, km->ir.count, km->btn.count, reload.reloads, reload.failures, km->cache.base ? ", cached" : "");
+    } else {
+        snprintf(reply, sizeof(reply), "error: section <name>, reload or status");
+    }
+    printf("Control \"%s\": %s\n", msg, reply);
+    if (len > sizeof(sa_family_t))
+        sendto(fd, reply, strlen(reply), 0, (struct sockaddr *)&from, len);
+}
+
+// True if the inotify events name KEYMAP_FILE
+bool keymap_touched(int fd) {
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    bool touched = false;
+    ssize_t n;
+
+    while ((n = read(fd, buf, sizeof(buf))) > 0) {
+        for (char *p = buf; p < buf + n; p += sizeof(struct inotify_event) + ((struct inotify_event *)p)->len) {
+            const struct inotify_event *ev = (const struct inotify_event *)p;
+            if (ev->len && !strcmp(ev->name, KEYMAP_FILE))
+                touched = true;
+        }
+    }
+    return touched;
+}
+
+void *reload_worker(void *arg) {
+    (void)arg;
+    struct pollfd fds[2] = { { .fd = reload.inotify, .events = POLLIN }, { .fd = reload.control, .events = POLLIN } };
+    char why[128];
+
+    while (!atomic_load(&reload.stop)) {
+        if (poll(fds, 2, 500) <= 0)			// wakes twice a second to notice stop
+            continue;
+        if (fds[1].revents & POLLIN)
+            control_handle(reload.control);
+        if ((fds[0].revents & POLLIN) && keymap_touched(reload.inotify)) {
+            do {					// until the editor is done
+                struct timespec settle = {0, RELOAD_SETTLE_MS * 1000000L};
+                nanosleep(&settle, NULL);
+            } while (keymap_touched(reload.inotify));
+            const keymaps_t *km = atomic_load(&keymaps);
+            bool ok = keymaps_reload(km->section, why, sizeof(why));
+            printf("%s changed, %s: %s\n", KEYMAP_FILE, ok ? "reloaded" : "kept the old keymap", why);
+        }
+    }
+    return NULL;
+}
+
+// Either source may be missing, the other still works
+int reload_start(void) {
+    reload.inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (reload.inotify < 0 || inotify_add_watch(reload.inotify, ".", IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+        perror("inotify on the keymap");
+    reload.control = control_open();
+    if (pthread_create(&reload.thread, NULL, reload_worker, NULL) != 0) {
+        perror("pthread_create reload");
+        return -1;
     }
     return 0;
 }
 
+void reload_stop(void) {
+    atomic_store(&reload.stop, true);
+    pthread_join(reload.thread, NULL);
+    if (reload.inotify >= 0) close(reload.inotify);
+    if (reload.control >= 0) {
+        close(reload.control);
+        unlink(CONTROL_SOCKET);
+    }
+}
+
+// Optional "Config" object: release_ms, rotary_ms, idle_ms, button_hold, ir_hold { "NEC": 14, ... },
+// power "sleep", "stop" or "standby"
+// Returns true if cfg was changed
+bool load_mcu_config(const cJSON *section, mcu_config_t *cfg) {
+    bool changed = false;
+    if (!section || !cJSON_IsObject(section))
+        return false;
+
+    struct { const char *name; uint16_t *ticks; } timeouts[] = {
+        { "release_ms", &cfg->releaseTicks },
+        { "rotary_ms", &cfg->rotaryTicks },
+        { "idle_ms", &cfg->idleTicks },
+    };
+    for (size_t i = 0; i < sizeof(timeouts) / sizeof(timeouts[0]); i++) {
+        cJSON *v = cJSON_GetObjectItem(section, timeouts[i].name);
+        if (cJSON_IsNumber(v) && v->valueint > 0 && v->valueint * TICKS_PER_MS <= 0xffff) {
+            *timeouts[i].ticks = v->valueint * TICKS_PER_MS;
+            changed = true;
+        }
+    }
+
+    struct { const char *name; uint16_t *ms; } gestures[] = {
+        { "long_ms", &cfg->longMs },
+        { "tap_ms", &cfg->tapMs },
+    };
+    for (size_t i = 0; i < sizeof(gestures) / sizeof(gestures[0]); i++) {
+        cJSON *v = cJSON_GetObjectItem(section, gestures[i].name);
+        if (cJSON_IsNumber(v) && v->valueint > 0 && v->valueint <= 0xffff) {
+            *gestures[i].ms = v->valueint;
+            changed = true;
+        }
+    }
+
+    cJSON *v = cJSON_GetObjectItem(section, "button_hold");
+    if (cJSON_IsNumber(v) && v->valueint > 0 && v->valueint <= 31) {
+        cfg->buttonHold = v->valueint;
+        changed = true;
+    }
+
+    const char *power_names[PWR_STATES] = { [PWR_SLEEP] = "sleep", [PWR_STOP] = "stop", [PWR_STANDBY] = "standby" };
+    v = cJSON_GetObjectItem(section, "power");
+    for (int s = PWR_SLEEP; s < PWR_STATES && cJSON_IsString(v); s++) {
+        if (!strcmp(v->valuestring, power_names[s])) {
+            cfg->powerMax = s;
+            changed = true;
+        }
+    }
+
+    cJSON *hold = cJSON_GetObjectItem(section, "ir_hold");
+    for (int p = 1; p < IR_PROTO_COUNT && cJSON_IsObject(hold); p++) {
+        v = cJSON_GetObjectItem(hold, ir_proto_names[p]);
+        if (cJSON_IsNumber(v) && v->valueint > 0 && v->valueint <= 31) {
+            cfg->irHold[p] = v->valueint;
+            changed = true;
+        }
+    }
+
+    return changed;
+}
+
+// Daemon side of the "Config" object: queue_depth, queue_policy "drop" or "wait"
+void load_queue_config(const cJSON *section) {
+    cJSON *v = cJSON_GetObjectItem(section, "queue_depth");
+    if (cJSON_IsNumber(v) && v->valueint > 0 && v->valueint <= QUEUE_DEPTH_MAX)
+        queue.depth = v->valueint;
+    v = cJSON_GetObjectItem(section, "queue_policy");
+    for (int p = QUEUE_DROP; p <= QUEUE_WAIT && cJSON_IsString(v); p++) {
+        if (!strcmp(v->valuestring, queue_policy_names[p]))
+            queue.policy = p;
+    }
+}
+
+// Keymap action for event byte 0, -1 for gestures without one
+int action_slot(uint8_t head) {
+    switch (EVT_GESTURE(head)) {
+        case GESTURE_PRESS: return ACT_PRESS;
+        case GESTURE_REPEAT: return ACT_REPEAT;
+        case GESTURE_LONG: return ACT_LONG;
+        case GESTURE_RELEASE: return ACT_RELEASE;
+        case GESTURE_TAP:
+            if (EVT_COUNT(head) >= 2 && EVT_COUNT(head) <= 3)
+                return ACT_TAP2 + EVT_COUNT(head) - 2;
+    }
+    return -1;
+}
+
 uint32_t get_scancode(uint8_t *buf) {
     return (buf[1] << 16) | (buf[2] << 8) | buf[3];
 }
@@ -233,146 +912,265 @@ uint32_t get_buttoncode(uint8_t *buf) {
     return (buf[4] << 24) | (buf[5] << 16) | (buf[6] << 8) | buf[7];
 }
 
-void process_ir(uint32_t scan_code) {
-    uint16_t keycode = lookup_code(scan_code, ir_table, ir_keycount);
-    char* keycommand = lookup_command(scan_code, ir_table, ir_keycount);
-    static struct timespec now, ts_next;
-    clock_gettime(CLOCK_REALTIME, &now);
-
-//printf("Scancode 0x%03x Keycode 0x%03x\n", scan_code, keycode);
-    if (keycode == 114 || keycode == 115 || keycode == 103 || keycode == 108) {
-        if ((i2c_data[0] & 0x1f) == 0x01) {
-            send_volumio_command(keycommand);
-            delay = INITIAL_DELAY;
-            ts_next.tv_sec = now.tv_sec; ts_next.tv_nsec = now.tv_nsec + (delay * 1e6);
-            if (ts_next.tv_nsec >= 1e9) {
-                ts_next.tv_sec++;
-                ts_next.tv_nsec -= 1e9;
-            }
+uint32_t get_stamp(uint8_t *buf) {
+    return buf[8] | (buf[9] << 8) | (buf[10] << 16) | ((uint32_t)buf[11] << 24);
+}
+
+// ms from an earlier event to the current one, wrap safe
+uint32_t ms_since(uint32_t stamp) {
+    return (uint32_t)(event_stamp - stamp) / TICKS_PER_MS;
+}
+
+// Accelerating rate for held keys, on the MCU's hold time: true on a press, then for
+// repeats once the delay has passed
+bool repeat_due(void) {
+    static uint16_t next, last;				// hold ms of next allowed repeat, of the last event
+
+    if (EVT_GESTURE(i2c_data[0]) == GESTURE_PRESS || event_hold < last) {
+        delay = INITIAL_DELAY;				// a new key, also when its PRESS got lost
+        next = delay;
+    }
+    last = event_hold;
+    if (EVT_GESTURE(i2c_data[0]) == GESTURE_PRESS)
+        return true;
+    if (event_hold < next)
+        return false;
+    delay = (delay > MINIMUM_DELAY) ? DECAY * delay : MINIMUM_DELAY;
+    next = event_hold + delay;
+    return true;
+}
+
+void process_ir(const keymaps_t *km, uint32_t scan_code) {
+    uint8_t gesture = EVT_GESTURE(i2c_data[0]);
+    const keymap_entry_t *key = keymap_find(&km->ir, event_proto, scan_code);	// one probe: keycode and all commands
+    if (!key && event_proto != IR_PROTO_NONE)
+        key = keymap_find(&km->ir, IR_PROTO_NONE, scan_code);	// section without a protocol
+    uint16_t keycode = key ? key->keycode : 0xffff;
+    const char* keycommand = keymap_command(&km->ir, key, action_slot(i2c_data[0]));
+    static bool held_long;				// GESTURE_LONG seen since the press
+
+//printf("Scancode 0x%03x Keycode 0x%03x %s Gesture %d Hold %u ms\n", scan_code, keycode, keycode_name(keycode), gesture, event_hold);
+    if (gesture == GESTURE_PRESS) {
+        held_long = false;
+        repeat_due();
+    } else if (gesture == GESTURE_LONG) {
+        held_long = true;
+    } else if (gesture == GESTURE_REPEAT) {
+        if (keycommand && repeat_due())
+            queue_command(keycommand);
+        return;
+    }
+
+    if (keycode == 116 && gesture == GESTURE_LONG && !keycommand) {
+        system("/sbin/poweroff");
+    }
+    else if (keycode >= 0x200 && keycode <= 0x209) {	// digits build a track number, long press a playlist
+        static uint32_t last_release_time;
+
+        if (gesture == GESTURE_LONG && !keycommand) {
+            char cmd[128];
+            snprintf(cmd, sizeof(cmd), "playplaylist&name=IR_%d", keycode - 0x200);
+            queue_command(cmd);
+            printf("long press, executing action for key %03d, %s\n", keycode - 0x200, cmd);
+            press_count = 0;
         }
-        else if (now.tv_sec > ts_next.tv_sec ||
-            (now.tv_sec == ts_next.tv_sec && now.tv_nsec > ts_next.tv_nsec)) {
-            send_volumio_command(keycommand);
-            delay = (delay > MINIMUM_DELAY) ? DECAY * delay : MINIMUM_DELAY;
-            ts_next.tv_sec = now.tv_sec; ts_next.tv_nsec = now.tv_nsec + (delay * 1e6);
-            if (ts_next.tv_nsec >= 1e9) {
-                ts_next.tv_sec++;
-                ts_next.tv_nsec -= 1e9;
+        else if (gesture == GESTURE_RELEASE && !held_long) {	// short press, might be one of several digits
+            if (ms_since(last_release_time) < 1000) {
+                press_count++;
             }
-        }
-    }
-    else if (keycode == 116) {
-        if ((i2c_data[0] & 0x1f) == 0x01) {
-            ts_next.tv_sec = now.tv_sec; ts_next.tv_nsec = now.tv_nsec + 8e8;
-            if (ts_next.tv_nsec >= 1e9) {
-                ts_next.tv_sec++;
-                ts_next.tv_nsec -= 1e9;
+            else {
+                press_count = 0;
             }
+            track_number *= 10;						// shift earlier keypress left for tracks up to 999
+            if (press_count % 3)						// start over when more than 3 short keypresses
+                track_number += keycode - 512;			// remember which key caused it
+            else track_number = keycode - 512;			// max 3 figures
+//            printf("press no %d, key %03d, track %d\n", press_count + 1, keycode - 512, track_number);
+
+            last_release_time = event_stamp;
+
+            // (Re)start the 500 ms timer — resets each press
+            struct itimerspec its = {0};
+            its.it_value.tv_sec = KEY_REPEAT_DELAY_MS / 1000;
+            its.it_value.tv_nsec = (KEY_REPEAT_DELAY_MS % 1000) * 1000000;
+            restart_debounce_timer(its);
         }
-        else if (now.tv_sec > ts_next.tv_sec ||
-            (now.tv_sec == ts_next.tv_sec && now.tv_nsec > ts_next.tv_nsec)) {
-            system("/sbin/poweroff");
+        else if (gesture != GESTURE_PRESS && keycommand) {	// other gestures bound in KEYMAP_FILE
+            queue_command(keycommand);
         }
     }
-    else if ((keycode >= 0x200 && keycode <= 0x209) || scan_code == 0xffffff) {
-        static uint16_t key;
-        static struct timespec press_time, release_time, last_release_time;
- 
-        if ((i2c_data[0] & 0x1f) == 0x01) {			// just pressed
-            key = keycode;					// remember keycode
-            clock_gettime(CLOCK_REALTIME, &press_time);
-        } else if (scan_code == 0xffffff && key) {		// just released
-            clock_gettime(CLOCK_REALTIME, &release_time);
-
-            uint32_t diff_ms = (release_time.tv_sec - press_time.tv_sec) * 1e3 +
-                (release_time.tv_nsec - press_time.tv_nsec) / 1e6;
-
-            uint32_t since_last_ms = (release_time.tv_sec - last_release_time.tv_sec) * 1e3 +
-                (release_time.tv_nsec - last_release_time.tv_nsec) / 1e6;
-
-            if (diff_ms >= 800) {				// Long press, act immediately
-                char cmd[128];
-                snprintf(cmd, sizeof(cmd), "playplaylist&name=IR_%d", key - 0x200);
-                send_volumio_command(cmd);
-                printf("long press, executing action for key %03d, %s\n", key - 0x200, cmd);
-                press_count = 0;
-            }
-            else {						// Short press, might be single or double
-                if(since_last_ms < 1000) {
-                    press_count++;
-                }
-                else {
-                    press_count = 0;
-                }
-                track_number *= 10;						// shift earlier keypress left for tracks up to 999
-                if(press_count % 3)						// start over when more than 3 short keypresses
-                    track_number += key - 512;			// remember which key caused it
-                else track_number = key - 512;			// max 3 figures
-//                printf("press no %d, key %03d, %d ms, track %d\n", press_count + 1, key - 512, since_last_ms, track_number);
-
-                last_release_time = release_time;
-
-                // (Re)start the 500 ms timer — resets each press
-                struct itimerspec its = {0};
-                its.it_value.tv_sec = KEY_REPEAT_DELAY_MS / 1000;
-                its.it_value.tv_nsec = (KEY_REPEAT_DELAY_MS % 1000) * 1000000;
-                if (timer_settime(debounce_timer, 0, &its, NULL) != 0)
-                    perror("timer_settime");
-            }
-        key = 0;						// reset
-        }
+    else if (keycommand) {				// keycommands set in KEYMAP_FILE, per gesture
+        queue_command(keycommand);
     }
-    else if ((i2c_data[0] & 0x1f) == 1) {			// other keycommands set in KEYMAP_FILE
-        send_volumio_command(keycommand);
+}
+
+// Set the register pointer, then read len bytes with a repeated start
+int read_register(uint8_t reg, uint8_t *buf, uint16_t len) {
+    return i2c_read(reg, buf, len);
+}
+
+int write_config(const mcu_config_t *cfg) {
+    return i2c_write(REG_CONFIG, (const uint8_t *)cfg, sizeof(mcu_config_t));
+}
+
+// Register block longer than one transfer, read FRAME_SIZE bytes at a time
+int read_block(uint8_t reg, uint8_t *buf, uint16_t len) {
+    for (uint16_t off = 0; off < len; off += FRAME_SIZE) {
+        if (read_register(reg + off, buf + off, len - off < FRAME_SIZE ? len - off : FRAME_SIZE) < 0)
+            return -1;
     }
+    return 0;
 }
 
-int read_i2c_data(void) {
-    int fd;
-    char *device = "/dev/i2c-1";  // Bus 1 for Linux
+// Diagnostics block twice, one second apart: totals since reset and load over that second
+int print_stats(void) {
+    const char *isr_names[DIAG_ISRS] = { "I2C", "CAPTURE_0", "TIMER_0", "GPIO/ADC", "QEI_0" };
+    diag_t before, after;
+    struct timespec t0, t1;
 
-    if ((fd = open(device, O_RDWR)) < 0) {
-        perror("Failed to open the bus");
-        return -1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    if (read_block(REG_DIAG, (uint8_t *)&before, sizeof(before)) < 0)
+        return 1;
+    sleep(1);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    if (read_block(REG_DIAG, (uint8_t *)&after, sizeof(after)) < 0)
+        return 1;
+
+    double us = (t1.tv_sec - t0.tv_sec) * 1e6 + (t1.tv_nsec - t0.tv_nsec) / 1e3;
+    double mhz = after.cpuMHz ? after.cpuMHz : 1;
+    printf("%-10s %10s %8s %8s %8s %8s\n", "ISR", "entries", "per s", "avg us", "max us", "load %");
+    for (int i = 0; i < DIAG_ISRS; i++) {
+        const diag_isr_t *a = &after.isr[i], *b = &before.isr[i];
+        printf("%-10s %10u %8u %8.1f %8.1f %8.3f\n", isr_names[i], a->count, a->count - b->count,
+            a->count ? a->cycles / mhz / a->count : 0, a->max / mhz,
+            100 * (uint32_t)(a->cycles - b->cycles) / mhz / us);
     }
+    printf("IR frames rejected:");
+    for (int p = 0; p < IR_PROTO_COUNT; p++)
+        printf(" %s %u", p ? ir_proto_names[p] : "unknown", after.irFail[p]);
+    printf("\nRPi wake pulses: %u\n", after.wakePulses);
 
-    struct i2c_msg msgs[1];
-    msgs[0].addr = 0x77;
-    msgs[0].flags = I2C_M_RD;
-    msgs[0].len = 8;
-    msgs[0].buf = i2c_data;
+    // CAPTURE_0 stops in STANDBY, so that share is what the other states leave of the second
+    const char *power_names[PWR_STATES] = { "run", "sleep", "stop", "standby" };
+    double counted = 0;
+    printf("%-10s %8s %8s\n", "state", "time %", "wake us");
+    for (int i = 0; i < PWR_STATES; i++) {
+        double share = i == PWR_STANDBY ? 100 - counted : 100 * 2.0 * (after.stateTicks[i] - before.stateTicks[i]) / us;
+        if (share < 0) share = 0;
+        counted += share;
+        printf("%-10s %8.2f %8u\n", power_names[i], share, after.wakeMax[i] * 2);
+    }
+    return 0;
+}
 
-    struct i2c_rdwr_ioctl_data rdwr_data;
-    rdwr_data.msgs = msgs;
-    rdwr_data.nmsgs = 1;
+// One byte: queued event count and STATUS_* flags, -1 on error
+int read_status(void) {
+    uint8_t status;
+    if (read_register(REG_STATUS, &status, 1) < 0)
+        return -1;
+    return status;
+}
 
-    if (ioctl(fd, I2C_RDWR, &rdwr_data) < 0) {
-        perror("I2C_RDWR ioctl failed");
-        close(fd);
+// Reads only the bytes that the events read_status() reported take.
+// Returns number of events in i2c_frame, -1 on error
+int read_i2c_data(int queued) {
+    uint8_t want = queued < EVT_BURST ? queued : EVT_BURST;
+    if (read_register(REG_FRAME, i2c_frame, FRAME_LEN(want)) < 0)
         return -1;
+    uint8_t n = i2c_frame[0] & STATUS_COUNT;
+    if (n > want) {					// more queued since the status read, the MCU keeps the frame
+        i2c_frame[1] = 0;
+        return 0;
     }
-    close(fd);
-    return 0;
+    if (crc8(i2c_frame, FRAME_LEN(n) - 1) != i2c_frame[FRAME_LEN(n) - 1]) {
+        torn_count++;
+        fprintf(stderr, "Frame CRC mismatch, discarded (%u torn)\n", torn_count);
+        i2c_frame[1] = 0;
+        return 0;
+    }
+    uint8_t seq = i2c_frame[2];
+    if (frame_seq >= 0 && seq == (uint8_t)frame_seq) {
+        fprintf(stderr, "Frame %u repeated, discarded\n", seq);
+        i2c_frame[1] = 0;
+        return 0;
+    }
+    if (frame_seq >= 0 && seq != (uint8_t)(frame_seq + 1)) {
+        missed_count += (uint8_t)(seq - frame_seq - 1);
+        fprintf(stderr, "Frame sequence %u after %d (%u missed)\n", seq, frame_seq, missed_count);
+    }
+    frame_seq = seq;
+    if (i2c_frame[0] & STATUS_OVERFLOW) {
+        overflow_count++;
+        fprintf(stderr, "MCU event queue overflowed (%u times)\n", overflow_count);
+    }
+    return n;
 }
 
-void handle_signal(void) {
+void process_event(void) {
+    uint32_t scancode = get_scancode(i2c_data);
+    uint32_t buttoncode = get_buttoncode(i2c_data);
+    const keymaps_t *km = atomic_load_explicit(&keymaps, memory_order_acquire);
+
+    if (buttoncode == 0x00000000) {
+        process_ir(km, scancode);
+    } else {
+        uint8_t gesture = EVT_GESTURE(i2c_data[0]);
+        const keymap_entry_t *button = keymap_find(&km->btn, IR_PROTO_NONE, buttoncode);
+        const char* buttoncommand = keymap_command(&km->btn, button, action_slot(i2c_data[0]));
+        if (gesture == GESTURE_REPEAT && !(buttoncommand && repeat_due()))
+            return;
+        if (gesture == GESTURE_PRESS)
+            repeat_due();
+        if (buttoncommand)
+            queue_command(buttoncommand);
+    }
+}
+
+void handle_signal(int sig) {
+    (void)sig;
     running = 0;
 }
 
-static void free_keymap(keymap_t *table, int count)
-{
-    for (int i = 0; i < count; ++i) {
-        free(table[i].keycommand);
-        table[i].keycommand = NULL;
-    }
+void usage(const char *name) {
+    fprintf(stderr, "usage: %s [-d /dev/i2c-N] [-a address] [-u volumio_url] [-m frames.txt] [--stats] [--compile] [ir_section]\n",
+        name);
 }
 
-int main(int argc, const char *argv[]) {
-    int ret = 0;
-    uint32_t scancode = 0, buttoncode = 0;
-    const char *ir_section = "default";
+int main(int argc, char *argv[]) {
+    int ret = 0, opt;
+    const char *ir_section = KEYMAP_ALL, *device = I2C_DEVICE, *frames = NULL;
+    uint8_t address = I2C_ADDRESS;
+    bool stats = false, compile = false;
+    static const struct option options[] = {
+        { "address", required_argument, NULL, 'a' },
+        { "device", required_argument, NULL, 'd' },
+        { "mock", required_argument, NULL, 'm' },
+        { "url", required_argument, NULL, 'u' },
+        { "stats", no_argument, NULL, 's' },
+        { "compile", no_argument, NULL, 'c' },
+        { NULL, 0, NULL, 0 }
+    };
+
+    while ((opt = getopt_long(argc, argv, "a:d:m:u:", options, NULL)) != -1) {
+        switch (opt) {
+            case 'a': address = strtoul(optarg, NULL, 0); break;
+            case 'd': device = optarg; break;
+            case 'm': frames = optarg; break;
+            case 'u': volumio_url = optarg; break;
+            case 's': stats = true; break;
+            case 'c': compile = true; break;
+            default: usage(argv[0]); return 1;
+        }
+    }
+    if (optind < argc) ir_section = argv[optind];
 
-    if (argc > 1) ir_section = argv[1];
+    if (!compile && (frames ? i2c_open_mock(frames) : i2c_open(device, address)))
+        return 1;
+    if (stats) {
+        ret = print_stats();
+        i2c_close();
+        return ret;
+    }
 
     setup_debounce_timer();
 
@@ -382,74 +1180,125 @@ int main(int argc, const char *argv[]) {
         // Not fatal but log
     }
 
-    bool ir_loaded = false, btn_loaded = false;
-    bool chip_opened = false;
+    bool chip_opened = false, queue_started = false, reload_started = false;
+    keymaps_t *km = keymaps_load(ir_section, compile);
+    uint32_t applied = 0;				// generation whose Config the MCU has
 
-    if (!load_keymap_section(KEYMAP_FILE, ir_section, ir_table, &ir_keycount, MAX_KEYS)) {
+    atomic_store(&keymaps, km);
+    if (!km) {
+        ret = 1;
+        goto cleanup;
+    }
+    if (compile)
+        goto cleanup;
+    if (!km->ir.count) {
         fprintf(stderr, "Failed to load IR keymap section '%s'\n", ir_section);
         ret = 1;
         goto cleanup;
     }
-    ir_loaded = true;
-
-    if (!load_keymap_section(KEYMAP_FILE, "Button", btn_table, &btn_keycount, MAX_BUTTONS)) {
+    if (!km->btn.count) {
         fprintf(stderr, "Failed to load Button keymap section\n");
         ret = 1;
         goto cleanup;
     }
-    btn_loaded = true;
 
-    if (open_gpiod_line(4)) {
+    load_queue_config(km->config);			// queue size and policy hold until restart
+    if (queue_start() < 0) {
         ret = 1;
         goto cleanup;
     }
-    chip_opened = true;
+    queue_started = true;
+
+    // From here on a stop lets the worker and the reload thread finish, see cleanup
+    struct sigaction stop = { .sa_handler = handle_signal };
+    sigemptyset(&stop.sa_mask);
+    sigaction(SIGINT, &stop, NULL);
+    sigaction(SIGTERM, &stop, NULL);
+
+    if (!frames) {
+        if (open_gpiod_line(GPIO_IRQ)) {
+            ret = 1;
+            goto cleanup;
+        }
+        chip_opened = true;
+        i2c_unstick = unstick_bus;
+    }
 
-    printf("Waiting for falling edge on GPIO4...\n");
+    uint8_t learn_off = 0;				// an ir-learn that died mid-capture leaves the decoder off
+    if (i2c_write(REG_LEARN, &learn_off, 1) < 0)
+        fprintf(stderr, "Could not take the MCU out of learn mode\n");
+
+    if (reload_start() == 0)
+        reload_started = true;
+
+    if (!frames)
+        printf("Waiting for falling edge on GPIO%d...\n", GPIO_IRQ);
 
     while (running) {
-        ret = gpiod_line_event_wait(line, &(struct timespec){1, 0});
+        struct timespec wait = {1, 0};
+        atomic_fetch_add(&keymaps_epoch, 1);		// no keymaps_t from the last pass in use
+        km = atomic_load(&keymaps);
+        if (km->generation != applied) {		// I2C stays on this thread, so the MCU part of a reload goes here
+            mcu_config_t mcu_config;
+            applied = km->generation;
+            if (read_register(REG_CONFIG, (uint8_t *)&mcu_config, sizeof(mcu_config)) == 0 &&
+                load_mcu_config(km->config, &mcu_config)) {
+                if (write_config(&mcu_config) == 0)
+                    printf("MCU configuration written\n");
+            }
+        }
+        debounce_poll(&wait);
+        ret = frames ? i2c_mock_wait(&wait) : gpiod_line_event_wait(line, &wait);
         if (ret < 0) {
+            if (frames || !running) {			// replay finished or SIGINT/SIGTERM, let the queue drain
+                ret = 0;
+                break;
+            }
             perror("Wait for event failed");
             break;
         } else if (ret > 0) {
-            ret = gpiod_line_event_read(line, &event);
+            ret = frames ? 0 : gpiod_line_event_read(line, &event);
             if (ret == 0) {
                 struct timespec small_delay = {0, 5000}; // 5us delay
                 nanosleep(&small_delay, NULL);
-                if (read_i2c_data() < 0) {
-                    fprintf(stderr, "read_i2c_data failed\n");
-                    break;
-                }
-                scancode = get_scancode(i2c_data);
-                buttoncode = get_buttoncode(i2c_data);
-            }
-
-            if (i2c_data[0] & 0x20) {
-                send_volumio_command("volume&volume=plus");
-            } else if (i2c_data[0] & 0x40) {
-                send_volumio_command("volume&volume=minus");
-            } else if (buttoncode == 0x00000000) {
-                process_ir(scancode);
-            } else {
-                char* buttoncommand = lookup_command(buttoncode, btn_table, btn_keycount);
-                if ((i2c_data[0] & 0x1f) == 1 && buttoncommand)
-                    send_volumio_command((const char*)buttoncommand);
-                else if ((i2c_data[0] & 0x1f) >= 24 && buttoncommand)
-                    system("/sbin/poweroff");
+                do {						// IRQ stays low while MCU has events queued, no new edge
+                    int status = read_status();		// 1 byte: what is queued, sizes the frame read
+                    if (status < 0 || !(status & (STATUS_COUNT | STATUS_QEI)))
+                        break;
+                    int n = read_i2c_data(status & STATUS_COUNT);
+                    if (n < 0) {				// retried and recovered in i2c_transport, wait for the next edge
+                        fprintf(stderr, "read_i2c_data failed\n");
+                        break;
+                    }
+                    if (i2c_frame[1])
+                        apply_volume_delta((int8_t)i2c_frame[1]);
+                    for (int i = 0; i < n; i++) {
+                        memcpy(i2c_data, &i2c_frame[FRAME_HDR + i * EVT_SIZE], sizeof(i2c_data));
+                        event_stamp = get_stamp(&i2c_frame[FRAME_HDR + i * EVT_SIZE]);
+                        event_hold = EVT_HOLD(&i2c_frame[FRAME_HDR + i * EVT_SIZE]);
+                        event_proto = EVT_PROTO(&i2c_frame[FRAME_HDR + i * EVT_SIZE]);
+                        process_event();
+                    }
+                } while (running);
             }
         }
     }
 
 cleanup:
-    if (ir_loaded) free_keymap(ir_table, ir_keycount);
-    if (btn_loaded) free_keymap(btn_table, btn_keycount);
+    if (reload_started) reload_stop();
+    if (queue_started) queue_stop();
+    keymaps_free(atomic_exchange(&keymaps, NULL));
 
     if (chip_opened) {
         gpiod_chip_close(chip);
         chip_opened = false;
     }
+    if (i2c_stats.retries || i2c_stats.failures)
+        fprintf(stderr, "I2C: %u transfers, %u retries, %u failed, %u recoveries\n", i2c_stats.transfers,
+            i2c_stats.retries, i2c_stats.failures, i2c_stats.recoveries);
+    i2c_close();
 
+    volumio_close();
     curl_global_cleanup();
 
     fprintf(stderr, "Clean exit from 1104-volumio.\n");
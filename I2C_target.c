@@ -1,23 +1,119 @@
 #include "ti_msp_dl_config.h"
-
-uint8_t gTxCount = 0;
-volatile uint8_t gData[8] = {0,0xff,0xff,0xff,0,0,0,0,};
-volatile uint8_t IR_State = 0, IR_Count = 0;
-volatile uint16_t IR_Data_RC5 = 0, captured = 0, last_capture = 0, pulse_width = 0;
-volatile uint32_t IR_Data_SIRC = 0, IR_Data_NEC = 0, NEC_DECODED = 0;
+#include "ir_decoder.h"
+#include "i2c_regmap.h"
+
+#define EVT_DEPTH       8                               // queued events, power of two
+#define KEY_SIZE        9                               // held_key_t data: head, scancode, buttons, IR protocol
+#define LADDER_MEM      ADC12_0_ADCMEM_LADDER           // keypad resistor ladder on PA24, see I2C_target.syscfg
+#define LADDER_START    DL_ADC12_SEQ_START_ADDR_01
+#define LADDER_KEYS     8
+#define LADDER_IDLE     LADDER_KEYS                     // no key pressed, pin pulled up to VDDA
+#define LADDER_HYST     64                              // window margin, no chatter at a boundary
+#define LADDER_BUTTON   4                               // ladder key 0 is button 4, BTN_TRIGGER_HAPPY5
+#define GPIO_BUTTONS    4                               // buttons 0..3, BTN_TRIGGER_HAPPY1..4
+#define BUTTONS         (LADDER_BUTTON + LADDER_KEYS)
+#define BUTTON_PINS     (GPIO_BUTTONS_BUTTON_1_PIN | GPIO_BUTTONS_BUTTON_2_PIN | \
+                         GPIO_BUTTONS_BUTTON_3_PIN | GPIO_BUTTONS_ROTARY_SWITCH_PIN)
+#define DEBOUNCE_SCANS  4                               // 20 ms of agreeing samples to flip a button
+#define CHORD_SCANS     10                              // 50 ms from the first press to PRESS the chord
+#define BUTTON_REPEAT_SCANS 10                          // 50 ms between REPEATs
+#define CAPTURE_TIMEOUTS (DL_TIMER_INTERRUPT_CC1_DN_EVENT | DL_TIMER_INTERRUPT_CC2_DN_EVENT | \
+                          DL_TIMER_INTERRUPT_CC3_DN_EVENT | DL_TIMER_INTERRUPT_CC4_DN_EVENT | \
+                          DL_TIMER_INTERRUPT_CC5_DN_EVENT)
+
+typedef struct {                                        // a key held on one source, IR or buttons
+    uint8_t data[KEY_SIZE];                             // [0]: 0x80 not read yet, frames held in bits 4..0
+    uint32_t pressStamp;                                // capture stamp of the press
+    uint8_t longSent;                                   // GESTURE_LONG already queued for this press
+} held_key_t;
+
+uint8_t gTxCount = 0, gTxLen = 0, gRxCount = 0;
+uint8_t gRegPtr = REG_FRAME;                            // register pointer, see i2c_regmap.h
+uint8_t gTxEvents = 0;                                  // events in gTxFrame, dropped at STOP
+uint8_t gTxSeq = 0;                                     // frames read by the host
+int8_t gTxDelta = 0;                                    // QEI delta in gTxFrame
+held_key_t gIrKey = { .data = {0,0xff,0xff,0xff,0,0,0,0,IR_PROTO_NONE} };     // buttons always 0
+held_key_t gButtonKey = { .data = {0,0xff,0xff,0xff,0,0,0,0,IR_PROTO_NONE} }; // scancode always none
+volatile uint8_t gEvents[EVT_DEPTH][EVT_SIZE];
+volatile uint8_t gEvtHead = 0, gEvtTail = 0;
+uint8_t gTxFrame[FRAME_SIZE];
+volatile uint8_t gEvtOverflow = 0;
+volatile int8_t gQeiDelta = 0;                          // detents since last read, + is clockwise
+volatile uint16_t gCaptureWraps = 0;                    // CAPTURE_0 periods, extends the 2 us stamp
+volatile uint8_t gWakeActive = 0;                       // SCL held low by RPi_wakePulse
+uint8_t gI2cBusy = 0;                                   // between START and STOP
+uint8_t gPowerFrom = PWR_RUN;                           // state the CPU left for the running ISR
+uint32_t gPowerStamp = 0;                               // capture stamp of the last wake-up
+uint32_t gStandbyWake = 0;                              // capture stamp of the last wake-up from STANDBY
+volatile uint16_t captured = 0, last_capture = 0, pulse_width = 0;
 volatile uint16_t gAdcResult;
-
-enum IR_State {
-    IR_IDLE,
-    IR_START,
-    IR_SIRC,
-    IR_NEC_DATA,
-    IR_RC5_START_0,
-    IR_RC5_MID_0,
-    IR_RC5_MID_1,
+volatile uint8_t gLadderKey = LADDER_IDLE;              // ADC keypad key, set by the window comparator
+uint8_t gButtonScan = 0;                                // TIMER_0 is scanning held buttons
+uint8_t gDebounce[BUTTONS];                             // integrators, 0 up .. DEBOUNCE_SCANS down
+uint16_t gButtonsHeld = 0;                              // debounced, bit n is button n
+uint16_t gChord = 0;                                    // buttons of the reported press, 0 none
+uint8_t gButtonTicks = 0;                               // scans since the chord started or repeated
+uint8_t gButtonWait = 0;                                // chord broken up, wait until all are up
+const uint32_t gButtonPins[GPIO_BUTTONS] = {
+    GPIO_BUTTONS_BUTTON_1_PIN, GPIO_BUTTONS_BUTTON_2_PIN, GPIO_BUTTONS_BUTTON_3_PIN,
+    GPIO_BUTTONS_ROTARY_SWITCH_PIN,
+};
+const uint16_t gLadderBounds[LADDER_KEYS] = {           // upper end of each key's level, 12 bit
+    256, 768, 1280, 1792, 2304, 2816, 3328, 3840,
+};
+ir_decoder_t gIR;
+uint32_t gTapEnd = 0;                                   // tap window closes, capture stamp
+uint8_t gTapKey[KEY_SIZE];                              // data of the tapped key, [0] = taps so far
+diag_t gDiag = { .cpuMHz = CPUCLK_FREQ / 1000000 };     // read by the host over I2C
+learn_t gLearn;                                         // raw IR for ir-learn
+mcu_config_t gConfig = {                                // written by the host over I2C
+    .irHold = {                                         // repeats before waking the Pi, ~1.5 s
+        [IR_PROTO_RC5] = 13,                            // 13*114 ms = 1482 ms
+        [IR_PROTO_SIRC] = 31,                           // 31*45 ms = 1385 ms
+        [IR_PROTO_NEC] = 14,                            // 14*110 ms = 1540 ms
+        [IR_PROTO_RC6] = 14,                            // 14*107 ms = 1498 ms
+        [IR_PROTO_SAMSUNG] = 14,                        // 14*108 ms = 1512 ms
+        [IR_PROTO_JVC] = 25,                            // 25*60 ms = 1500 ms
+    },
+    .buttonHold = 31,                                   // 31*50 ms = 1550 ms
+    .powerMax = PWR_STOP,                               // STANDBY loses the first IR frame after idle
+    .releaseTicks = 60000,                              // 120 ms
+    .rotaryTicks = 20000,                               // 40 ms
+    .idleTicks = 60000,                                 // 120 ms
+    .longMs = 800,
+    .tapMs = 400,
 };
+_Static_assert(IR_PROTO_COUNT <= IR_PROTOCOLS, "mcu_config_t.irHold too small");
+_Static_assert(REG_CONFIG + sizeof(mcu_config_t) <= REG_DIAG, "register blocks overlap");
+_Static_assert(REG_DIAG + sizeof(diag_t) <= REG_LEARN, "register blocks overlap");
+_Static_assert(REG_LEARN + sizeof(learn_t) <= 0x100, "gRegPtr is 8 bit");
 
 void RPi_wakePulse(void);
+void RPi_wakeEnd(void);
+void event_push(uint8_t gesture, const uint8_t *data, uint32_t press);
+uint8_t event_frame(void);
+void event_commit(void);
+void i2c_receive(void);
+void i2c_prepare(void);
+uint32_t capture_stamp(void);
+void capture_arm(uint8_t index, uint32_t interrupt, uint16_t ticks);
+void ir_report(uint8_t proto, uint32_t code, uint8_t hold);
+void key_count(held_key_t *key, uint8_t hold);
+void diag_exit(uint8_t isr, uint32_t entry);
+void diag_clear(void);
+void i2c_window(const void *src, uint8_t size, uint8_t offset);
+void learn_edge(uint16_t width);
+void ladder_init(void);
+void ladder_window(uint16_t level);
+void button_start(void);
+uint16_t button_sample(void);
+void button_report(void);
+void power_sleep(void);
+uint8_t power_select(void);
+uint8_t gesture_step(held_key_t *key);
+void gesture_release(held_key_t *key);
+void tap_timer(void);
+void tap_flush(void);
 
 int main(void)
 {
@@ -35,15 +131,18 @@ int main(void)
         }
     }
     DL_I2C_setTargetOwnAddress(I2C_INST, i2cAddress);
+    ladder_init();                                      // ADC12_0 is the keypad from here on
 
     DL_GPIO_setPins(GPIO_LEDS_PORT, GPIO_LEDS_USER_LED_1_PIN);
 
     NVIC_EnableIRQ(I2C_INST_INT_IRQN);
     NVIC_EnableIRQ(GPIO_BUTTONS_INT_IRQN);
+    NVIC_EnableIRQ(ADC12_0_INST_INT_IRQN);
     NVIC_EnableIRQ(QEI_0_INST_INT_IRQN);
     NVIC_EnableIRQ(TIMER_0_INST_INT_IRQN);
     NVIC_EnableIRQ(CAPTURE_0_INST_INT_IRQN);
     DL_Timer_enableInterrupt(CAPTURE_0_INST, DL_TIMER_INTERRUPT_CC0_DN_EVENT);
+    DL_Timer_enableInterrupt(CAPTURE_0_INST, DL_TIMER_INTERRUPT_ZERO_EVENT);
     DL_Timer_startCounter(CAPTURE_0_INST);
 
     DL_GPIO_disableOutput(GPIO_LEDS_PORT, GPIO_LEDS_IRQ_PIN);
@@ -51,293 +150,556 @@ int main(void)
     DL_SYSCTL_setSYSOSCFreq(DL_SYSCTL_SYSOSC_FREQ_4M);
     DL_GPIO_clearPins(GPIO_LEDS_PORT, GPIO_LEDS_USER_LED_1_PIN);
 
-    DL_SYSCTL_enableSleepOnExit();
+    SysTick->LOAD = 0xffffff;                           // free running, ISR cycle counts
+    SysTick->VAL = 0;
+    SysTick->CTRL = SysTick_CTRL_CLKSOURCE_Msk | SysTick_CTRL_ENABLE_Msk;
+
+    DL_GPIO_enableWakeUp(GPIO_CAPTURE_0_C0_IOMUX);     // STANDBY0 wake-up pins, no effect in STOP0
+    DL_GPIO_enableWakeUp(GPIO_QEI_0_PHA_IOMUX);
+    DL_GPIO_enableWakeUp(GPIO_QEI_0_PHB_IOMUX);
+    DL_GPIO_enableWakeUp(GPIO_BUTTONS_ROTARY_SWITCH_IOMUX);
+    DL_GPIO_enableWakeUp(GPIO_BUTTONS_BUTTON_1_IOMUX);
+    DL_GPIO_enableWakeUp(GPIO_BUTTONS_BUTTON_2_IOMUX);
+    DL_GPIO_enableWakeUp(GPIO_BUTTONS_BUTTON_3_IOMUX);
 
     while (1) {
-        __WFI();
+        power_sleep();
     }
 }
 
 void I2C_INST_IRQHandler(void)
 {
+    uint32_t entry = SysTick->VAL;
+
     switch (DL_I2C_getPendingInterrupt(I2C_INST)) {
 
-        case DL_I2C_IIDX_TARGET_START:
-            gTxCount = 0;
+        case DL_I2C_IIDX_TARGET_START:                  // also repeated start after pointer write
+            gI2cBusy = 1;
+            i2c_receive();
+            gTxCount = gRxCount = 0;
             DL_I2C_flushTargetTXFIFO(I2C_INST);
+            i2c_prepare();
+            break;
+
+        case DL_I2C_IIDX_TARGET_RXFIFO_TRIGGER:
+            i2c_receive();
             break;
 
         case DL_I2C_IIDX_TARGET_TXFIFO_TRIGGER:
-            if (gTxCount < 8) {
-                gTxCount += DL_I2C_fillTargetTXFIFO(I2C_INST, (const uint8_t *)&gData[gTxCount], 8 - gTxCount);
+            if (gTxCount < gTxLen) {
+                gTxCount += DL_I2C_fillTargetTXFIFO(I2C_INST, &gTxFrame[gTxCount], gTxLen - gTxCount);
             } else while (DL_I2C_transmitTargetDataCheck(I2C_INST, 0x00) != false) ;
             break;
 
         case DL_I2C_IIDX_TARGET_STOP:
-            gData[0] &= 0x1f;
-            DL_GPIO_disableOutput(GPIO_LEDS_PORT, GPIO_LEDS_IRQ_PIN);
+            gI2cBusy = 0;
+            i2c_receive();
+            if (gRegPtr == REG_FRAME && !gRxCount && gTxCount >= gTxLen)
+                event_commit();                         // frame was read up to its CRC
+            gRegPtr = REG_FRAME;
+            gIrKey.data[0] &= 0x1f;                     // host is awake, no wake pulse for either
+            gButtonKey.data[0] &= 0x1f;
+            if (gEvtHead == gEvtTail && gQeiDelta == 0) // keep IRQ low while events are queued
+                DL_GPIO_disableOutput(GPIO_LEDS_PORT, GPIO_LEDS_IRQ_PIN);
             DL_GPIO_togglePins(GPIO_LEDS_PORT, GPIO_LEDS_USER_LED_1_PIN);
             break;
 
        default:
             break;
     }
+    diag_exit(DIAG_I2C, entry);
+}
+
+void i2c_receive(void) {                                // first byte sets gRegPtr, rest are register writes
+    uint8_t *cfg = (uint8_t *)&gConfig;
+
+    while (!DL_I2C_isTargetRXFIFOEmpty(I2C_INST)) {
+        uint8_t byte = DL_I2C_receiveTargetData(I2C_INST);
+        if (!gRxCount++) {
+            gRegPtr = byte;
+            continue;
+        }
+        if (gRegPtr >= REG_CONFIG && gRegPtr < REG_CONFIG + sizeof(mcu_config_t))
+            cfg[gRegPtr - REG_CONFIG] = byte;
+        else if (gRegPtr >= REG_DIAG && gRegPtr < REG_DIAG + sizeof(diag_t))
+            diag_clear();
+        else if (gRegPtr == REG_LEARN) {
+            gLearn.count = 0;
+            gLearn.state = byte ? LEARN_ARMED : LEARN_OFF;
+            ir_reset(&gIR);
+        }
+        gRegPtr++;
+    }
+}
+
+void i2c_prepare(void) {                                // load gTxFrame from gRegPtr
+    uint8_t n = (gEvtHead - gEvtTail) & (EVT_DEPTH - 1);
+
+    gTxLen = 0;
+    if (gRegPtr == REG_STATUS) {
+        gTxFrame[0] = n | (gQeiDelta ? STATUS_QEI : 0) | (gEvtOverflow ? STATUS_OVERFLOW : 0);
+        gTxLen = 1;
+    } else if (gRegPtr == REG_FRAME) {
+        gTxLen = event_frame();
+    } else if (gRegPtr >= REG_CONFIG && gRegPtr < REG_CONFIG + sizeof(mcu_config_t)) {
+        i2c_window(&gConfig, sizeof(mcu_config_t), gRegPtr - REG_CONFIG);
+    } else if (gRegPtr >= REG_DIAG && gRegPtr < REG_DIAG + sizeof(diag_t)) {
+        i2c_window(&gDiag, sizeof(diag_t), gRegPtr - REG_DIAG);
+    } else if (gRegPtr >= REG_LEARN && gRegPtr < REG_LEARN + sizeof(learn_t)) {
+        i2c_window(&gLearn, sizeof(learn_t), gRegPtr - REG_LEARN);
+    }
+}
+
+void i2c_window(const void *src, uint8_t size, uint8_t offset) {   // up to FRAME_SIZE bytes, one snapshot
+    const uint8_t *from = (const uint8_t *)src + offset;
+
+    while (offset++ < size && gTxLen < FRAME_SIZE)
+        gTxFrame[gTxLen++] = *from++;
 }
 
 void QEI_0_INST_IRQHandler(void)
 {
-    gData[0] |= DL_Timer_getQEIDirection(QEI_0_INST) ? 0xa0 : 0xc0;
+    uint32_t entry = SysTick->VAL;
+
+    if (DL_Timer_getQEIDirection(QEI_0_INST)) {
+        if (gQeiDelta < 127) gQeiDelta++;
+    } else if (gQeiDelta > -127) gQeiDelta--;
     DL_GPIO_enableOutput(GPIO_LEDS_PORT, GPIO_LEDS_IRQ_PIN);
     DL_Timer_setCaptureCompareValue(CAPTURE_0_INST,
-        (DL_Timer_getTimerCount(CAPTURE_0_INST) - 20000),                   // 40 ms timeout for Rotary
+        (DL_Timer_getTimerCount(CAPTURE_0_INST) - gConfig.rotaryTicks),     // 40 ms timeout for Rotary
         DL_TIMER_CC_5_INDEX);
     DL_Timer_clearInterruptStatus(CAPTURE_0_INST, DL_TIMER_INTERRUPT_CC5_DN_EVENT);
     DL_Timer_enableInterrupt(CAPTURE_0_INST, DL_TIMER_INTERRUPT_CC5_DN_EVENT);
+    diag_exit(DIAG_QEI, entry);
 }
 
 void GPIOA_IRQHandler(void) {
-    gData[0] |= 0x80;
-    gData[7] |= 0x01;
-    DL_GPIO_enableOutput(GPIO_LEDS_PORT, GPIO_LEDS_IRQ_PIN);
+    uint32_t entry = SysTick->VAL;
+
+    button_start();
+    diag_exit(DIAG_GPIO, entry);
+}
+
+void ADC12_0_INST_IRQHandler(void) {                    // ladder level left the window
+    uint32_t entry = SysTick->VAL;
+
+    switch (DL_ADC12_getPendingInterrupt(ADC12_0_INST)) {
+        case DL_ADC12_IIDX_WINDOW_COMP_HIGH:
+        case DL_ADC12_IIDX_WINDOW_COMP_LOW:
+            ladder_window(DL_ADC12_getMemResult(ADC12_0_INST, LADDER_MEM));
+            if (gLadderKey != LADDER_IDLE && !gButtonScan)
+                button_start();
+            break;
+        default:
+            break;
+    }
+    diag_exit(DIAG_GPIO, entry);
+}
+
+void button_start(void) {                               // TIMER_0 scans until every button is up
+    gButtonScan = 1;
+    gButtonKey.data[0] |= 0x80;
     NVIC_DisableIRQ(GPIO_BUTTONS_INT_IRQN);
     DL_Timer_startCounter(TIMER_0_INST);
     NVIC_EnableIRQ(TIMER_0_INST_INT_IRQN);
 }
 
-void TIMER_0_INST_IRQHandler(void) {
-    if (DL_GPIO_readPins(GPIO_BUTTONS_PORT, GPIO_BUTTONS_ROTARY_SWITCH_PIN)) {
-        gData[0] &= 0xe0;
-        gData[7] &= 0xfe;
+void TIMER_0_INST_IRQHandler(void) {                    // one 5 ms scan of all buttons
+    uint32_t entry = SysTick->VAL;
+    uint16_t raw = button_sample(), held = gButtonsHeld, settling = 0;
+
+    for (uint8_t n = 0; n < BUTTONS; n++) {             // integrate, flip at either end
+        uint16_t bit = 1 << n;
+        if (raw & bit) {
+            if (gDebounce[n] < DEBOUNCE_SCANS && ++gDebounce[n] == DEBOUNCE_SCANS) held |= bit;
+        } else if (gDebounce[n] && !--gDebounce[n]) held &= ~bit;
+        if (gDebounce[n]) settling = 1;
+    }
+    gButtonsHeld = held;
+
+    if (gChord) {
+        if (held != gChord) {                           // chord is over
+            gesture_release(&gButtonKey);
+            gButtonWait = (held & gChord) != gChord;    // one let go: wait for all up, one added: new chord
+            gChord = gButtonTicks = 0;
+        } else if (++gButtonTicks == BUTTON_REPEAT_SCANS) {
+            gButtonTicks = 0;
+            button_report();
+        }
+    } else if (held && !gButtonWait && ++gButtonTicks == CHORD_SCANS) {
+        gButtonTicks = 0;                               // everything pressed so far is one chord
+        gChord = held;
+        gButtonKey.data[4] = gButtonKey.data[5] = gButtonKey.data[6] = gButtonKey.data[7] = 0;
+        for (uint8_t n = 0; n < BUTTONS; n++)
+            if (held & (1 << n)) gButtonKey.data[4 + (n & 3)] |= 1 << (n >> 2);
+        button_report();
+    }
+
+    if (!settling) {                                    // all up and no bounce left
+        gButtonKey.data[0] &= 0xe0;
+        gButtonKey.data[4] = gButtonKey.data[5] = gButtonKey.data[6] = gButtonKey.data[7] = 0;
+        gButtonScan = gButtonWait = gButtonTicks = 0;
         DL_Timer_stopCounter(TIMER_0_INST);
         NVIC_DisableIRQ(TIMER_0_INST_INT_IRQN);
+        DL_GPIO_clearInterruptStatus(GPIO_BUTTONS_PORT, BUTTON_PINS);
         NVIC_EnableIRQ(GPIO_BUTTONS_INT_IRQN);
         DL_Timer_setCaptureCompareValue(CAPTURE_0_INST,
-            (DL_Timer_getTimerCount(CAPTURE_0_INST) - 60000),
+            (DL_Timer_getTimerCount(CAPTURE_0_INST) - gConfig.idleTicks),
             DL_TIMER_CC_1_INDEX);
         DL_Timer_clearInterruptStatus(CAPTURE_0_INST, DL_TIMER_INTERRUPT_CC1_DN_EVENT);
         DL_Timer_enableInterrupt(CAPTURE_0_INST, DL_TIMER_INTERRUPT_CC1_DN_EVENT);
-    } else {
-        if ((gData[0] & 0x1f) < 31) gData[0]++;
-        else if (gData[0] & 0x80) RPi_wakePulse();          // pulse only if i2c not active
-        gData[0] |= 0x80;
     }
-    DL_GPIO_enableOutput(GPIO_LEDS_PORT, GPIO_LEDS_IRQ_PIN);
+    diag_exit(DIAG_TIMER, entry);
+}
+
+uint16_t button_sample(void) {                          // raw pressed mask, bit n is button n
+    uint32_t pins = ~DL_GPIO_readPins(GPIO_BUTTONS_PORT, BUTTON_PINS);    // low while pressed
+    uint16_t raw = 0;
+
+    for (uint8_t n = 0; n < GPIO_BUTTONS; n++)
+        if (pins & gButtonPins[n]) raw |= 1 << n;
+    if (gLadderKey != LADDER_IDLE)
+        raw |= 1 << (LADDER_BUTTON + gLadderKey);
+    return raw;
+}
+
+void button_report(void) {                              // PRESS, REPEAT or LONG for the chord in data[4..7]
+    key_count(&gButtonKey, gConfig.buttonHold);
+    event_push(gesture_step(&gButtonKey), gButtonKey.data, gButtonKey.pressStamp);
     DL_GPIO_togglePins(GPIO_LEDS_PORT, GPIO_LEDS_USER_LED_1_PIN);
 }
 
 void CAPTURE_0_INST_IRQHandler(void) {
+    uint32_t entry = SysTick->VAL;
+    uint32_t code;
+    uint8_t proto, state, last;
+    uint16_t late;
 
     uint8_t irqStatus = DL_Timer_getPendingInterrupt(CAPTURE_0_INST);
     switch (irqStatus) {
 
         case DL_TIMER_IIDX_CC0_DN:
-        last_capture = captured;
-        captured = DL_Timer_getCaptureCompareValue(CAPTURE_0_INST, DL_TIMER_CC_0_INDEX);
-        pulse_width = last_capture - captured;
-        // set long timeout:
-        DL_Timer_setCaptureCompareValue(
-            CAPTURE_0_INST,
-            (captured - 60000),
-            DL_TIMER_CC_5_INDEX);
-
-            switch (IR_State) {
-                case IR_IDLE:
-                    // start long timeout:
-                    DL_Timer_clearInterruptStatus(CAPTURE_0_INST, DL_TIMER_INTERRUPT_CC5_DN_EVENT);
-                    DL_Timer_enableInterrupt(CAPTURE_0_INST, DL_TIMER_INTERRUPT_CC5_DN_EVENT);
-                    IR_State = IR_START;
-                    break;
-
-                case IR_START:
-                    IR_Data_SIRC = IR_Data_RC5 = IR_Count = 0;
-                    // start long timeout:
-                    DL_Timer_clearInterruptStatus(CAPTURE_0_INST, DL_TIMER_INTERRUPT_CC5_DN_EVENT);
-                    DL_Timer_enableInterrupt(CAPTURE_0_INST, DL_TIMER_INTERRUPT_CC5_DN_EVENT);
-                    if (pulse_width > 1500 / 2 && pulse_width < 2100 / 2) {                 // 1.78 ms
-                        IR_Data_RC5 = 0x2000;
-                        IR_Count = 2;               // First start bit
-                        // short timeout for RC5:
-                        DL_Timer_setCaptureCompareValue(CAPTURE_0_INST, (captured - 2000), 2);
-                        DL_Timer_clearInterruptStatus(CAPTURE_0_INST, DL_TIMER_INTERRUPT_CC2_DN_EVENT);
-                        DL_Timer_enableInterrupt(CAPTURE_0_INST, DL_TIMER_INTERRUPT_CC2_DN_EVENT);
-                        IR_State = IR_RC5_MID_1;    // RC5 start
-                    } else if (pulse_width > 2800 / 2 && pulse_width < 3200 / 2) {          // 3.0 ms
-                        IR_State = IR_SIRC;         // SIRC start
-                    } else if (pulse_width > 10125 / 2 && pulse_width < 12375 / 2) {        // 11.25 ms
-                        // short timeout for NEC: 
-                        DL_Timer_setCaptureCompareValue(CAPTURE_0_INST, (captured - 1500), 4);
-                        DL_Timer_clearInterruptStatus(CAPTURE_0_INST, DL_TIMER_INTERRUPT_CC4_DN_EVENT);
-                        DL_Timer_enableInterrupt(CAPTURE_0_INST, DL_TIMER_INTERRUPT_CC4_DN_EVENT);
-                        IR_State = IR_IDLE;         // NEC repeat
-                    } else if (pulse_width > 12375 / 2 && pulse_width < 14625 / 2) {        // 13.5 ms
-                        IR_Data_NEC = 0;
-                        IR_State = IR_NEC_DATA;     // NEC start
-                    } else IR_State = IR_IDLE;
-                        break;
-
-                case IR_RC5_MID_1:
-                    if (pulse_width > 1600 / 2 && pulse_width < 2000 / 2) {
-                        IR_Data_RC5 |= (1 << (14 - IR_Count++));        // emit 1
-                    } else if (pulse_width > 2500 / 2 && pulse_width < 2900 / 2) {
-                        IR_Data_RC5 |= (1 << (14 - IR_Count++));        // emit 1
-                        IR_State = IR_RC5_MID_0;
-                    } else if (pulse_width > 3400 / 2 && pulse_width < 3800 / 2) {
-                        IR_Data_RC5 |= (1 << (14 - IR_Count++));        // emit 1
-                        IR_Count++;                                     // emit 0
-                    }
-                    // start short timeout:
-                    DL_Timer_setCaptureCompareValue(CAPTURE_0_INST, (captured - 2000), 2);
-                    break;
-
-                case IR_RC5_MID_0:
-                    if (pulse_width > 1600 / 2 && pulse_width < 2000 / 2) {
-                        IR_Count++;                                     // emit 0
-                    } else if (pulse_width > 2500 / 2 && pulse_width < 2900 / 2) {
-                        IR_Count++;                                     // emit 0
-                        IR_Data_RC5 |= (1 << (13 - IR_Count++));        // emit 1
-                        IR_State = IR_RC5_START_0;
-                    }
-                    // start short timeout:
-                    DL_Timer_setCaptureCompareValue(CAPTURE_0_INST, (captured - 2000), 2);
-                    break;
-
-                case IR_RC5_START_0:
-                    if (pulse_width > 1600 / 2 && pulse_width < 2000 / 2) {
-                        IR_Data_RC5 |= (1 << (13 - IR_Count++));        // emit 1
-                    } else if (pulse_width > 2500 / 2 && pulse_width < 2900 / 2) {
-                        IR_Count ++;                                    // emit 0  
-                        IR_State = IR_RC5_MID_0;
-                    } else if (pulse_width > 3400 / 2 && pulse_width < 3800 / 2) {
-                        IR_Count++;                                     // emit 0
-                        IR_Data_RC5 |= (1 << (13 - IR_Count++));        // emit 1
-                        IR_State = IR_RC5_MID_1;
-                    }
-                    // start short timeout:
-                   DL_Timer_setCaptureCompareValue(CAPTURE_0_INST, (captured - 2000), 2);
-                    break;
-
-                case IR_SIRC:                                           // SIRC bit collection
-                    // short timeout for SIRC:
-                    DL_Timer_setCaptureCompareValue(CAPTURE_0_INST, (captured - 1500), 3);
-                    DL_Timer_clearInterruptStatus(CAPTURE_0_INST, DL_TIMER_INTERRUPT_CC3_DN_EVENT);
-                    DL_Timer_enableInterrupt(CAPTURE_0_INST, DL_TIMER_INTERRUPT_CC3_DN_EVENT);
-                    if (pulse_width > 900 / 2 && pulse_width < 2100 / 2) {
-                        if (pulse_width > 1500 / 2) {
-                            IR_Data_SIRC |= (1 << IR_Count);            // 1-bit
-                        }
-                    IR_Count++;
-                    } else {
-                        IR_Count = 0;
-                        IR_State = IR_IDLE;                             // Invalid pulse
-                    }
-                    break;
-                case IR_NEC_DATA:                                       // NEC bit collection
-                    // short timeout for NEC:
-                    DL_Timer_setCaptureCompareValue(CAPTURE_0_INST, captured - 1500, 4);
-                    DL_Timer_clearInterruptStatus(CAPTURE_0_INST, DL_TIMER_INTERRUPT_CC4_DN_EVENT);
-                    DL_Timer_enableInterrupt(CAPTURE_0_INST, DL_TIMER_INTERRUPT_CC4_DN_EVENT);
-                    if (pulse_width > 875 / 2 && pulse_width < 1375 / 2)
-                        IR_Count++;
-                    else if (pulse_width > 2000 / 2 && pulse_width < 2500 / 2)
-                        IR_Data_NEC |= (1 << IR_Count++);
-                    else {
-                        IR_Count = 0;
-                        IR_State = IR_IDLE;                             // Invalid pulse
-                    }
-                    break;
-                default:
-                    IR_Count = 0;
-                    IR_State = IR_IDLE;
-                    break;
+            last_capture = captured;
+            captured = DL_Timer_getCaptureCompareValue(CAPTURE_0_INST, DL_TIMER_CC_0_INDEX);
+            pulse_width = last_capture - captured;
+            late = captured - DL_Timer_getTimerCount(CAPTURE_0_INST);  // edge to here, 2 us ticks
+            if (late > gDiag.wakeMax[gPowerFrom]) gDiag.wakeMax[gPowerFrom] = late;
+            // start long timeout:
+            capture_arm(DL_TIMER_CC_5_INDEX, DL_TIMER_INTERRUPT_CC5_DN_EVENT, gConfig.releaseTicks);
+            if (gLearn.state != LEARN_OFF) {
+                learn_edge(pulse_width);
+                break;
             }
+            state = gIR.state;
+            last = gIR.proto;
+            proto = ir_edge(&gIR, pulse_width);
+            if (!proto && gIR.state == IR_IDLE && state != IR_IDLE)     // invalid pulse
+                gDiag.irFail[state == IR_DATA ? last : IR_PROTO_NONE]++;
+            if (proto)                                                  // short end of frame timeout
+                capture_arm(DL_TIMER_CC_2_INDEX, DL_TIMER_INTERRUPT_CC2_DN_EVENT, ir_gap(proto));
             break;
 
         case DL_TIMER_IIDX_CC1_DN:                                      // Restore idle state
             DL_GPIO_togglePins(GPIO_LEDS_PORT, GPIO_LEDS_USER_LED_1_PIN);
-            DL_GPIO_disableOutput(GPIO_LEDS_PORT, GPIO_LEDS_IRQ_PIN);
-            gData[0] = 0x00;
+            if (gEvtHead == gEvtTail && gQeiDelta == 0)
+                DL_GPIO_disableOutput(GPIO_LEDS_PORT, GPIO_LEDS_IRQ_PIN);
+            if (!(gIrKey.data[0] & 0x1f)) gIrKey.data[0] = 0;           // a key still held keeps its count
+            if (!(gButtonKey.data[0] & 0x1f)) gButtonKey.data[0] = 0;
             DL_Timer_disableInterrupt(CAPTURE_0_INST, DL_TIMER_INTERRUPT_CC1_DN_EVENT);
-            IR_Count = 0;
-            IR_State = IR_IDLE;
+            ir_reset(&gIR);
             break;
 
-        case DL_TIMER_IIDX_CC2_DN:                                      // RC5 data processing
-            DL_GPIO_togglePins(GPIO_LEDS_PORT, GPIO_LEDS_USER_LED_1_PIN);
-            gData[3] = IR_Data_RC5 & 0x3f;
-            gData[2] = (IR_Data_RC5 >> 6) & 0x1f;
-            gData[1] = 0x00;
-            if ((gData[0] & 0x1f) < 13) gData[0]++;                     // 13*114 ms = 1482 ms
-            else if (gData[0] & 0x80) RPi_wakePulse();                  // pulse only if i2c not active
-            gData[0] |= 0x80;
-            DL_GPIO_enableOutput(GPIO_LEDS_PORT, GPIO_LEDS_IRQ_PIN);
+        case DL_TIMER_IIDX_CC2_DN:                                      // IR data processing
             DL_Timer_disableInterrupt(CAPTURE_0_INST, DL_TIMER_INTERRUPT_CC2_DN_EVENT);
-            IR_Count = 0;
-            IR_State = IR_IDLE;
+            state = gIR.pending;
+            proto = ir_finish(&gIR, &code);
+            if (gIR.repeat && !(gIrKey.data[0] & 0x1f))
+                proto = IR_PROTO_NONE;                                  // repeat code, but its frame was missed
+            if (proto)
+                ir_report(proto, code, gConfig.irHold[proto]);
+            else gDiag.irFail[state]++;                                 // short frame or bad checksum
             break;
 
-        case DL_TIMER_IIDX_CC3_DN:                                      // SIRC data processing
-            DL_GPIO_togglePins(GPIO_LEDS_PORT, GPIO_LEDS_USER_LED_1_PIN);
-            gData[3] = IR_Data_SIRC & 0x7f;
-            gData[2] = (IR_Data_SIRC >> 12) & 0xff;
-            gData[1] = (IR_Data_SIRC >> 7) & 0x1f;
-            if ((gData[0] & 0x1f) < 31) gData[0]++;                     // 31*45 ms = 1385 ms
-            else if (gData[0] & 0x80) RPi_wakePulse();                  // pulse only if i2c not active
-            gData[0] |= 0x80;
-            DL_GPIO_enableOutput(GPIO_LEDS_PORT, GPIO_LEDS_IRQ_PIN);
+        case DL_TIMER_IIDX_CC3_DN:                                      // end of RPi wake pulse
             DL_Timer_disableInterrupt(CAPTURE_0_INST, DL_TIMER_INTERRUPT_CC3_DN_EVENT);
-            IR_Count = 0;
-            IR_State = IR_IDLE;
+            RPi_wakeEnd();
             break;
 
-        case DL_TIMER_IIDX_CC4_DN:                                      // NEC data processing
-            DL_GPIO_togglePins(GPIO_LEDS_PORT, GPIO_LEDS_USER_LED_1_PIN);
-            if ((IR_Data_NEC & 0x00ff00ff) + ((IR_Data_NEC & 0xff00ff00) >> 8) == 0x00ff00ff)       // nec
-                NEC_DECODED = ((IR_Data_NEC & 0x00ff0000) >> 16) + ((IR_Data_NEC & 0x000000ff) << 8);
-            else if ((IR_Data_NEC & 0x00ff0000) + ((IR_Data_NEC & 0xff000000) >> 8) == 0x00ff0000)  // necx
-                NEC_DECODED = ((IR_Data_NEC & 0x00ff0000) >> 16) + ((IR_Data_NEC & 0x0000ffff) << 8);
-            else NEC_DECODED = 0;                                                                   // error
-            gData[3] = NEC_DECODED & 0xff;
-            gData[2] = (NEC_DECODED >> 8) & 0xff;
-            gData[1] = (NEC_DECODED >> 16) & 0xff;
-            if ((gData[0] & 0x1f) < 14) gData[0]++;                     // 14*110 ms = 1540 ms
-            else if (gData[0] & 0x80) RPi_wakePulse();                  // pulse only if i2c not active
-            gData[0] |= 0x80;
-            DL_GPIO_enableOutput(GPIO_LEDS_PORT, GPIO_LEDS_IRQ_PIN);
-            DL_Timer_disableInterrupt(CAPTURE_0_INST, DL_TIMER_INTERRUPT_CC4_DN_EVENT);
-            IR_Count = 0;
-            IR_State = IR_IDLE;
+        case DL_TIMER_IIDX_CC4_DN:                                      // tap window
+            if ((gIrKey.data[0] | gButtonKey.data[0]) & 0x1f)           // pressed again, release re-arms
+                DL_Timer_disableInterrupt(CAPTURE_0_INST, DL_TIMER_INTERRUPT_CC4_DN_EVENT);
+            else tap_timer();
+            break;
+
+        case DL_TIMER_IIDX_ZERO:                                        // 131 ms period wrap
+            gCaptureWraps++;
             break;
 
         case DL_TIMER_IIDX_CC5_DN:                                      // IR & QEI data reset
             DL_GPIO_togglePins(GPIO_LEDS_PORT, GPIO_LEDS_USER_LED_1_PIN);
-            gData[1] = gData[2] = gData[3] = 0xff;
-            gData[0] = 0x80;
             DL_Timer_disableInterrupt(CAPTURE_0_INST, DL_TIMER_INTERRUPT_CC5_DN_EVENT);
-            DL_GPIO_enableOutput(GPIO_LEDS_PORT, GPIO_LEDS_IRQ_PIN);
-            DL_Timer_setCaptureCompareValue(CAPTURE_0_INST, (captured - 60000), 1);
-            DL_Timer_clearInterruptStatus(CAPTURE_0_INST, DL_TIMER_INTERRUPT_CC1_DN_EVENT);
-            DL_Timer_enableInterrupt(CAPTURE_0_INST, DL_TIMER_INTERRUPT_CC1_DN_EVENT);
-            IR_Count = 0;
-            IR_State = IR_IDLE;
+            if (gLearn.state == LEARN_CAPTURE)
+                gLearn.state = LEARN_DONE;                              // frame is over
+            gesture_release(&gIrKey);                                   // held buttons are TIMER_0's
+            gIrKey.data[1] = gIrKey.data[2] = gIrKey.data[3] = 0xff;
+            gIrKey.data[8] = IR_PROTO_NONE;
+            gIrKey.data[0] = 0x80;
+            capture_arm(DL_TIMER_CC_1_INDEX, DL_TIMER_INTERRUPT_CC1_DN_EVENT, gConfig.idleTicks);
+            ir_reset(&gIR);
             break;
         default:
-            IR_Count = 0;
-            IR_State = IR_IDLE;
+            ir_reset(&gIR);
             break;
     }
+    diag_exit(DIAG_CAPTURE, entry);
+}
+
+void diag_exit(uint8_t isr, uint32_t entry) {           // SysTick counts down, 24 bit
+    diag_isr_t *d = &gDiag.isr[isr];
+    uint32_t cycles = (entry - SysTick->VAL) & 0xffffff;
+
+    d->count++;
+    d->cycles += cycles;
+    if (cycles > d->max) d->max = cycles > 0xffff ? 0xffff : cycles;
+    gPowerFrom = PWR_RUN;                                       // later ISRs of this wake-up were not asleep
 }
 
-void RPi_wakePulse(void) {
+// STOP0 keeps SYSOSC, so CAPTURE_0, QEI, TIMER_0, the ADC and I2C run on and wake-up costs a few
+// cycles. STANDBY0 stops MFCLK: CAPTURE_0, QEI and the ADC halt, and only pin edges wake the CPU.
+// The edge that wakes it is not captured, so the first IR frame or detent after idle is lost and
+// the ADC keypad is not seen until something else wakes the MCU. Hence powerMax defaults to STOP.
+void power_sleep(void) {                                // one sleep in the deepest state the pending work allows
+    uint8_t state;
+    uint32_t stamp;
+
+    __disable_irq();                                    // no timeout may be armed between choosing and sleeping
+    state = power_select();
+    if (state == PWR_SLEEP) DL_SYSCTL_setPowerPolicyRUN0SLEEP0();
+    else if (state == PWR_STOP) DL_SYSCTL_setPowerPolicySTOP0();
+    else DL_SYSCTL_setPowerPolicySTANDBY0();
+    stamp = capture_stamp();
+    gDiag.stateTicks[PWR_RUN] += stamp - gPowerStamp;
+    __WFI();                                            // returns with the waking IRQ pending
+    gPowerStamp = capture_stamp();
+    gDiag.stateTicks[state] += gPowerStamp - stamp;
+    gPowerFrom = state;
+    if (state == PWR_STANDBY) gStandbyWake = gPowerStamp;
+    __enable_irq();
+}
+
+uint8_t power_select(void) {
+    uint8_t state = PWR_STANDBY;
+
+    if (gI2cBusy)
+        state = PWR_SLEEP;                              // TX FIFO refills without a wake-up delay
+    else if (DL_Timer_getEnabledInterrupts(CAPTURE_0_INST, CAPTURE_TIMEOUTS) || gButtonScan || gWakeActive ||
+            gIR.state != IR_IDLE || gIR.pending || gLearn.state != LEARN_OFF ||
+            gEvtHead != gEvtTail || gQeiDelta)
+        state = PWR_STOP;                               // a timeout is counting or the Pi is about to read
+    else if (gPowerStamp - gStandbyWake < gConfig.idleTicks)
+        state = PWR_STOP;                               // woken by a pin: catch the rest of the burst, ZERO rechecks
+    return state < gConfig.powerMax ? state : gConfig.powerMax;
+}
+
+void diag_clear(void) {
+    gDiag = (diag_t){ .cpuMHz = CPUCLK_FREQ / 1000000 };
+}
+
+void capture_arm(uint8_t index, uint32_t interrupt, uint16_t ticks) {
+    DL_Timer_setCaptureCompareValue(CAPTURE_0_INST, (captured - ticks), index);
+    DL_Timer_clearInterruptStatus(CAPTURE_0_INST, interrupt);
+    DL_Timer_enableInterrupt(CAPTURE_0_INST, interrupt);
+}
+
+void learn_edge(uint16_t width) {                       // the width before the first edge means nothing
+    if (gLearn.state == LEARN_ARMED) {
+        gLearn.state = LEARN_CAPTURE;
+    } else if (gLearn.state == LEARN_CAPTURE) {
+        gLearn.width[gLearn.count++] = width;
+        if (gLearn.count == LEARN_DEPTH) gLearn.state = LEARN_DONE;
+    }
+}
+
+void ladder_init(void) {                                // free running, averaged, wakes only on a level change
+    DL_ADC12_disableConversions(ADC12_0_INST);
+    DL_ADC12_initSingleSample(ADC12_0_INST, DL_ADC12_REPEAT_MODE_ENABLED, DL_ADC12_SAMPLING_SOURCE_AUTO,
+        DL_ADC12_TRIG_SRC_SOFTWARE, DL_ADC12_SAMP_CONV_RES_12_BIT, DL_ADC12_SAMP_CONV_DATA_FORMAT_UNSIGNED);
+    DL_ADC12_setStartAddress(ADC12_0_INST, LADDER_START);   // pin, averaging and window come from SysConfig
+    ladder_window(0xfff);
+    DL_ADC12_clearInterruptStatus(ADC12_0_INST,
+        DL_ADC12_INTERRUPT_WINDOW_COMP_HIGH | DL_ADC12_INTERRUPT_WINDOW_COMP_LOW);
+    DL_ADC12_enableInterrupt(ADC12_0_INST,
+        DL_ADC12_INTERRUPT_WINDOW_COMP_HIGH | DL_ADC12_INTERRUPT_WINDOW_COMP_LOW);
+    DL_ADC12_enableConversions(ADC12_0_INST);
+    DL_ADC12_startConversion(ADC12_0_INST);
+}
+
+void ladder_window(uint16_t level) {                    // key for an averaged level, window around its band
+    uint8_t key = 0;
+
+    while (key < LADDER_KEYS && level >= gLadderBounds[key]) key++;
+    gLadderKey = key;
+    DL_ADC12_configWinCompLowThld(ADC12_0_INST, key ? gLadderBounds[key - 1] - LADDER_HYST : 0);
+    DL_ADC12_configWinCompHighThld(ADC12_0_INST, key < LADDER_KEYS ? gLadderBounds[key] + LADDER_HYST : 0xfff);
+}
+
+void ir_report(uint8_t proto, uint32_t code, uint8_t hold) {   // hold: repeats before waking the Pi
+    DL_GPIO_togglePins(GPIO_LEDS_PORT, GPIO_LEDS_USER_LED_1_PIN);
+    uint8_t *d = gIrKey.data;
+
+    if ((d[0] & 0x1f) && (proto != d[8] || code != ((uint32_t)d[1] << 16 | d[2] << 8 | d[3])))
+        gesture_release(&gIrKey);                               // other key or remote without a gap in between
+    d[3] = code & 0xff;
+    d[2] = (code >> 8) & 0xff;
+    d[1] = (code >> 16) & 0xff;
+    d[8] = proto;
+    key_count(&gIrKey, hold);
+    event_push(gesture_step(&gIrKey), d, gIrKey.pressStamp);
+}
+
+void key_count(held_key_t *key, uint8_t hold) {         // one more frame of the held key, saturates at 31
+    uint8_t count = key->data[0] & 0x1f;
+
+    if (count >= hold && (key->data[0] & 0x80)) RPi_wakePulse();    // pulse only if i2c not active
+    if (count < 0x1f) key->data[0]++;
+    key->data[0] |= 0x80;
+}
+
+uint8_t gesture_step(held_key_t *key) {                 // count just went up: PRESS, LONG once, else REPEAT
+    uint32_t now = capture_stamp();
+
+    if ((key->data[0] & 0x1f) == 1) {
+        uint8_t other = 0;
+        for (uint8_t i = 1; i < KEY_SIZE; i++) other |= gTapKey[i] ^ key->data[i];
+        if (gTapKey[0] && (other || (int32_t)(now - gTapEnd) >= 0))
+            tap_flush();                                        // other key or too late, series is over
+        key->pressStamp = now;
+        key->longSent = 0;
+        return GESTURE_PRESS;
+    }
+    if (!key->longSent && now - key->pressStamp >= (uint32_t)gConfig.longMs * US(1000)) {
+        key->longSent = 1;
+        return GESTURE_LONG;
+    }
+    return GESTURE_REPEAT;
+}
+
+void gesture_release(held_key_t *key) {                 // RELEASE the held key, a short press is a tap
+    if (!(key->data[0] & 0x1f)) return;
+    event_push(GESTURE_RELEASE, key->data, key->pressStamp);
+    key->data[0] &= 0xe0;
+    if (key->longSent) {
+        if (gTapKey[0]) tap_flush();
+        return;
+    }
+    for (uint8_t i = 1; i < KEY_SIZE; i++) gTapKey[i] = key->data[i];
+    if (gTapKey[0] < 0x1f) gTapKey[0]++;
+    gTapEnd = capture_stamp() + (uint32_t)gConfig.tapMs * US(1000);
+    tap_timer();
+}
+
+void tap_timer(void) {                                  // CC4 in steps of at most 120 ms up to gTapEnd
+    int32_t left = gTapEnd - capture_stamp();
+
+    if (left <= 0) {
+        tap_flush();
+        return;
+    }
+    DL_Timer_setCaptureCompareValue(CAPTURE_0_INST,
+        (DL_Timer_getTimerCount(CAPTURE_0_INST) - (left > 60000 ? 60000 : left)),
+        DL_TIMER_CC_4_INDEX);
+    DL_Timer_clearInterruptStatus(CAPTURE_0_INST, DL_TIMER_INTERRUPT_CC4_DN_EVENT);
+    DL_Timer_enableInterrupt(CAPTURE_0_INST, DL_TIMER_INTERRUPT_CC4_DN_EVENT);
+}
+
+void tap_flush(void) {                                  // queue TAP with the number of taps
+    DL_Timer_disableInterrupt(CAPTURE_0_INST, DL_TIMER_INTERRUPT_CC4_DN_EVENT);
+    event_push(GESTURE_TAP, gTapKey, 0);
+    gTapKey[0] = 0;
+}
+
+void event_push(uint8_t gesture, const uint8_t *data, uint32_t press) {   // queue snapshot, raise IRQ line
+    volatile uint8_t *evt = gEvents[gEvtHead];
+    uint32_t stamp = capture_stamp(), hold = stamp - press;
+
+    evt[0] = gesture << 5 | (data[0] & 0x1f);
+    for (uint8_t i = 1; i < 8; i++) evt[i] = data[i];
+    evt[8] = stamp & 0xff;
+    evt[9] = (stamp >> 8) & 0xff;
+    evt[10] = (stamp >> 16) & 0xff;
+    evt[11] = stamp >> 24;
+    if (gesture == GESTURE_PRESS || gesture == GESTURE_TAP) hold = 0;
+    else if (hold >= US(65535000)) hold = 0xffff;
+    else hold = (hold * 131) >> 16;                             // 2 us ticks to ms without a divide, -0.05%
+    evt[12] = hold & 0xff;
+    evt[13] = hold >> 8;
+    evt[14] = data[8];
+    if (((gEvtHead + 1) & (EVT_DEPTH - 1)) == gEvtTail)         // full: drop newest, a frame may be in flight
+        gEvtOverflow = 1;
+    else gEvtHead = (gEvtHead + 1) & (EVT_DEPTH - 1);
+    DL_GPIO_enableOutput(GPIO_LEDS_PORT, GPIO_LEDS_IRQ_PIN);
+}
+
+uint32_t capture_stamp(void) {                          // up-counting 2 us ticks, wraps after 2.4 h
+    uint16_t count = DL_Timer_getTimerCount(CAPTURE_0_INST);
+    uint16_t wraps = gCaptureWraps;
+
+    // wrap not yet serviced because we are in another ISR
+    if (DL_Timer_getRawInterruptStatus(CAPTURE_0_INST, DL_TIMER_INTERRUPT_ZERO_EVENT) && count > 0x8000)
+        wraps++;
+    return ((uint32_t)wraps << 16) | (uint16_t)~count;
+}
+
+// Copy up to EVT_BURST events into gTxFrame, CRC right after the last one. Returns the
+// frame length. gTxCount runs ahead of the bus by the TX FIFO depth at most, which is
+// less than EVT_SIZE, so a host that read fewer events never reaches this CRC.
+uint8_t event_frame(void) {
+    uint8_t n = 0, tail = gEvtTail, *dst = &gTxFrame[FRAME_HDR];
+
+    while (n < EVT_BURST && tail != gEvtHead) {
+        for (uint8_t i = 0; i < EVT_SIZE; i++) *dst++ = gEvents[tail][i];
+        tail = (tail + 1) & (EVT_DEPTH - 1);
+        n++;
+    }
+    gTxEvents = n;
+    gTxDelta = gQeiDelta;
+    gTxFrame[0] = n | (gEvtOverflow ? STATUS_OVERFLOW : 0);
+    gTxFrame[1] = gTxDelta;
+    gTxFrame[2] = gTxSeq;
+    *dst = crc8(gTxFrame, FRAME_LEN(n) - 1);
+    return FRAME_LEN(n);
+}
+
+void event_commit(void) {                               // frame reached the host, drop what it carried
+    gEvtTail = (gEvtTail + gTxEvents) & (EVT_DEPTH - 1);
+    gQeiDelta -= gTxDelta;                                      // clear on read, keep later detents
+    if (gTxFrame[0] & STATUS_OVERFLOW) gEvtOverflow = 0;
+    gTxEvents = gTxDelta = 0;
+    gTxSeq++;
+}
+
+void RPi_wakePulse(void) {                              // returns at once, CC3 ends the pulse
+    if (gWakeActive) return;
+    gWakeActive = 1;
+    gDiag.wakePulses++;
     DL_I2C_disableTarget(I2C_INST);
     DL_GPIO_initPeripheralInputFunction(IOMUX_PINCM2, IOMUX_PINCM2_PF_GPIOA_DIO01);
     DL_GPIO_enableOutput(GPIOA, DL_GPIO_PIN_1);
 
     DL_GPIO_setPins(GPIOA, DL_GPIO_PIN_1);                              // idle high
     DL_GPIO_clearPins(GPIOA, DL_GPIO_PIN_1);                            // pulse low
-    DL_Common_delayCycles(40000);                               // ~10 ms @ 4 MHz
+    DL_Timer_setCaptureCompareValue(CAPTURE_0_INST,
+        (DL_Timer_getTimerCount(CAPTURE_0_INST) - US(WAKE_PULSE_MS * 1000)),
+        DL_TIMER_CC_3_INDEX);
+    DL_Timer_clearInterruptStatus(CAPTURE_0_INST, DL_TIMER_INTERRUPT_CC3_DN_EVENT);
+    DL_Timer_enableInterrupt(CAPTURE_0_INST, DL_TIMER_INTERRUPT_CC3_DN_EVENT);
+}
+
+void RPi_wakeEnd(void) {
     DL_GPIO_setPins(GPIOA, DL_GPIO_PIN_1);                              // back to high
 
     DL_GPIO_initPeripheralInputFunction(IOMUX_PINCM2, IOMUX_PINCM2_PF_I2C0_SCL);
     DL_I2C_enableTarget(I2C_INST);
+    gWakeActive = 0;
 }
 
@@ -0,0 +1,183 @@
+// gcc -Wall -Wextra -O2 -o http-bench http-bench.c volumio_http.c -lcurl
+// ./http-bench [-n requests] [-d server_delay_us] [-c requests_per_connection] [-u url]
+//
+// Times Volumio commands the way 1104-volumio sends them: a new curl handle and TCP
+// connection per command, as before, against the kept-alive handle of volumio_http.c.
+// Without -u a mock Volumio on 127.0.0.1 answers every request after server_delay_us.
+// -c makes the mock close the connection after that many requests, so the
+// reconnect path gets exercised too.
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <curl/curl.h>
+#include "volumio_http.h"
+
+#define MAX_REQUESTS 100000
+
+static const char state_body[] = "{\"status\":\"play\",\"volume\":42,\"mute\":false}";
+
+// One connection, requests answered in order until the client or -c closes it
+static void serve(int fd, int delay_us, int per_conn) {
+    char buf[4096];
+    size_t len = 0;
+    int served = 0;
+
+    for (;;) {
+        char *end;
+        buf[len] = '\0';
+        while (!(end = strstr(buf, "\r\n\r\n"))) {
+            if (len == sizeof(buf) - 1) return;
+            ssize_t n = read(fd, buf + len, sizeof(buf) - 1 - len);
+            if (n <= 0) return;
+            len += n;
+            buf[len] = '\0';
+        }
+        if (delay_us) nanosleep(&(struct timespec){ 0, delay_us * 1000L }, NULL);
+
+        int head = !strncmp(buf, "HEAD ", 5), last = per_conn && ++served >= per_conn;
+        char reply[512];
+        int n = snprintf(reply, sizeof(reply), "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n"
+            "Content-Length: %zu\r\n%s\r\n%s", sizeof(state_body) - 1,
+            last ? "Connection: close\r\n" : "", head ? "" : state_body);
+        if (write(fd, reply, n) != n) return;
+        if (last) return;
+
+        end += 4;
+        len -= end - buf;
+        memmove(buf, end, len);
+    }
+}
+
+static pid_t mock_server(int *port, int delay_us, int per_conn) {
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    socklen_t alen = sizeof(addr);
+    int s = socket(AF_INET, SOCK_STREAM, 0);
+
+    if (s < 0 || bind(s, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(s, 8) < 0 ||
+        getsockname(s, (struct sockaddr *)&addr, &alen) < 0) {
+        perror("mock server");
+        return -1;
+    }
+    *port = ntohs(addr.sin_port);
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        return -1;
+    }
+    if (pid == 0) {                                     // the client runs one request at a time
+        for (;;) {
+            int fd = accept(s, NULL, NULL);
+            if (fd < 0) continue;
+            serve(fd, delay_us, per_conn);
+            close(fd);
+        }
+    }
+    close(s);
+    return pid;
+}
+
+// The old send_volumio_command(): handle and connection per command
+static int command_fresh(const char *cmd) {
+    char url[256];
+    CURL *curl = curl_easy_init();
+    if (!curl) return -1;
+    snprintf(url, sizeof(url), "%s/api/v1/commands/?cmd=%s", volumio_url, cmd);
+    curl_easy_setopt(curl, CURLOPT_NOBODY, 1L);
+    curl_easy_setopt(curl, CURLOPT_URL, url);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 2L);
+    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+    CURLcode res = curl_easy_perform(curl);
+    curl_easy_cleanup(curl);
+    return res == CURLE_OK ? 0 : -1;
+}
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void run(const char *name, int (*send)(const char *), int n, uint64_t *us) {
+    int errors = 0;
+    struct timespec t0, t1;
+
+    for (int i = 0; i < n; i++) {
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        if (send("volume&volume=plus") < 0) errors++;
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        us[i] = (t1.tv_sec - t0.tv_sec) * 1000000ULL + (t1.tv_nsec - t0.tv_nsec) / 1000;
+    }
+    qsort(us, n, sizeof(us[0]), cmp_u64);
+
+    uint64_t sum = 0;
+    for (int i = 0; i < n; i++) sum += us[i];
+    printf("%-11s %8.1f %8llu %8llu %8llu %7d\n", name, (double)sum / n, (unsigned long long)us[n / 2],
+        (unsigned long long)us[n * 99 / 100], (unsigned long long)us[n - 1], errors);
+}
+
+int main(int argc, char *argv[]) {
+    int requests = 1000, delay_us = 0, per_conn = 0, port = 0, opt;
+    const char *url = NULL;
+    char base[64];
+
+    while ((opt = getopt(argc, argv, "n:d:c:u:")) != -1) {
+        switch (opt) {
+            case 'n': requests = atoi(optarg); break;
+            case 'd': delay_us = atoi(optarg); break;
+            case 'c': per_conn = atoi(optarg); break;
+            case 'u': url = optarg; break;
+            default:
+                fprintf(stderr, "usage: %s [-n requests] [-d server_delay_us] [-c requests_per_connection] "
+                    "[-u url]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (requests < 1 || requests > MAX_REQUESTS) {
+        fprintf(stderr, "requests must be 1..%d\n", MAX_REQUESTS);
+        return 1;
+    }
+    uint64_t *us = malloc(requests * sizeof(*us));
+    if (!us) {
+        perror("malloc");
+        return 1;
+    }
+
+    pid_t server = 0;
+    if (!url) {
+        signal(SIGPIPE, SIG_IGN);
+        if ((server = mock_server(&port, delay_us, per_conn)) < 0)
+            return 1;
+        snprintf(base, sizeof(base), "http://127.0.0.1:%d", port);
+        url = base;
+    }
+    volumio_url = url;
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+
+    printf("%d commands to %s\n", requests, url);
+    printf("%-11s %8s %8s %8s %8s %7s\n", "client", "avg us", "p50 us", "p99 us", "max us", "errors");
+    run("fresh", command_fresh, requests, us);
+    run("keep-alive", volumio_command, requests, us);
+
+    char body[256];
+    int len = volumio_get("/api/v1/getState", body, sizeof(body));
+    printf("getState on the same handle: %s\n", len > 0 ? body : "failed");
+
+    volumio_close();
+    curl_global_cleanup();
+    if (server > 0) {
+        kill(server, SIGTERM);
+        waitpid(server, NULL, 0);
+    }
+    free(us);
+    return 0;
+}
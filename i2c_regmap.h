@@ -0,0 +1,125 @@
+#ifndef I2C_REGMAP_H
+#define I2C_REGMAP_H
+
+#include <stdint.h>
+
+// Register map of the MSPM0 I2C target, shared by I2C_target.c and 1104-volumio.c.
+// A write sets the register pointer with its first byte, further bytes are stored
+// from there on. The pointer returns to REG_FRAME after every STOP, so a plain read
+// always fetches the event frame.
+// The host reads REG_STATUS first and then FRAME_LEN() of the events it reported. A
+// frame is only dropped from the MCU's queue once its CRC byte went out, so a frame
+// that grew after the status read stays queued and is read again in full.
+
+#define REG_STATUS      0x00                            // R: queued events, STATUS_* flags
+#define REG_FRAME       0x10                            // R: event FIFO window, drained on read
+#define REG_CONFIG      0x20                            // R/W: mcu_config_t
+#define REG_DIAG        0x40                            // R: diag_t, any write clears it
+#define REG_LEARN       0xa8                            // R: learn_t, write 1 to capture raw IR, 0 to stop
+
+#define WAKE_PULSE_MS   10                              // SCL held low to wake the Pi, the bus NACKs meanwhile
+
+#define STATUS_COUNT    0x0f                            // events waiting
+#define STATUS_QEI      0x40                            // rotary moved since last frame
+#define STATUS_OVERFLOW 0x80                            // events dropped since last frame
+
+#define EVT_SIZE        15                              // key snapshot, 32-bit capture stamp, hold ms, IR protocol
+#define EVT_BURST       4                               // events per frame
+#define FRAME_HDR       3                               // count | STATUS_OVERFLOW, QEI delta, sequence
+#define FRAME_LEN(n)    (FRAME_HDR + (n) * EVT_SIZE + 1)        // n events, then CRC-8 over everything before it
+#define FRAME_SIZE      FRAME_LEN(EVT_BURST)
+
+// Event byte 0: gesture in bits 7..5, frames since the press or tap count in bits 4..0,
+// saturating at 31. Bytes 12..13: ms since the press for REPEAT, LONG and RELEASE.
+// Byte 14: IR_PROTO_* that decoded the scancode in bytes 1..3, IR_PROTO_NONE for buttons.
+#define EVT_GESTURE(b)  ((b) >> 5)
+#define EVT_COUNT(b)    ((b) & 0x1f)
+#define EVT_HOLD(e)     ((e)[12] | (e)[13] << 8)
+#define EVT_PROTO(e)    ((e)[14])
+
+enum Gesture {
+    GESTURE_NONE,
+    GESTURE_PRESS,                                      // first frame of a key
+    GESTURE_REPEAT,                                     // key still held, one per repeat frame or 50 ms
+    GESTURE_LONG,                                       // held for longMs, sent once per press
+    GESTURE_RELEASE,                                    // key let go, count = frames it was held
+    GESTURE_TAP,                                        // tapMs after the last short press, count = taps
+};
+
+#define IR_PROTOCOLS    8                               // room for IR_PROTO_COUNT
+
+typedef struct {
+    uint8_t irHold[IR_PROTOCOLS];                       // 0x20: IR repeats before waking the Pi
+    uint8_t buttonHold;                                 // 0x28: button repeats before waking the Pi
+    uint8_t powerMax;                                   // 0x29: deepest Power_State the MCU may enter
+    uint16_t releaseTicks;                              // 0x2a: no IR edge to release event, 2 us ticks
+    uint16_t rotaryTicks;                               // 0x2c: last detent to release event
+    uint16_t idleTicks;                                 // 0x2e: release event to idle
+    uint16_t longMs;                                    // 0x30: hold time for GESTURE_LONG
+    uint16_t tapMs;                                     // 0x32: release to next press to count as a tap
+} mcu_config_t;                                         // little endian on both sides
+
+enum Power_State {
+    PWR_RUN,                                            // CPU awake
+    PWR_SLEEP,                                          // CPU clock gated, an I2C transfer is open
+    PWR_STOP,                                           // STOP0: timers, QEI, ADC and I2C keep running
+    PWR_STANDBY,                                        // STANDBY0: pin wake-up only, see I2C_target.c
+    PWR_STATES,
+};
+
+enum Diag_ISR {
+    DIAG_I2C,
+    DIAG_CAPTURE,
+    DIAG_TIMER,
+    DIAG_GPIO,                                          // GPIOA and the ADC keypad
+    DIAG_QEI,
+    DIAG_ISRS,
+};
+
+typedef struct {
+    uint32_t count;                                     // entries
+    uint32_t cycles;                                    // CPU cycles in total, average is cycles / count
+    uint16_t max;                                       // longest entry in cycles, saturates
+    uint16_t reserved;
+} diag_isr_t;
+
+typedef struct {
+    diag_isr_t isr[DIAG_ISRS];                          // 0x40
+    uint16_t irFail[IR_PROTOCOLS];                      // 0x7c: frames rejected, [0] unknown leader
+    uint16_t wakePulses;                                // 0x8c: RPi wake pulses issued
+    uint16_t cpuMHz;                                    // 0x8e: cycles per us
+    uint32_t stateTicks[PWR_STATES];                    // 0x90: 2 us ticks per Power_State, STANDBY stops the count
+    uint16_t wakeMax[PWR_STATES];                       // 0xa0: worst IR edge to capture ISR, by state it woke from
+} diag_t;                                               // longer than FRAME_SIZE, read it in pieces
+
+#define LEARN_DEPTH     40                              // widths, one frame of any supported protocol
+
+enum Learn_State {
+    LEARN_OFF,                                          // IR decoded as usual
+    LEARN_ARMED,                                        // waiting for the first edge
+    LEARN_CAPTURE,                                      // storing widths, decoder bypassed
+    LEARN_DONE,                                         // buffer full or releaseTicks without an edge
+};
+
+typedef struct {
+    uint8_t count;                                      // 0xa8: widths stored
+    uint8_t state;                                      // 0xa9: Learn_State
+    uint16_t width[LEARN_DEPTH];                        // 0xaa: 2 us ticks between falling edges
+} learn_t;
+
+// CRC-8, polynomial 0x07, nibble table to keep flash and cycles low on the M0+
+static inline uint8_t crc8(const uint8_t *buf, uint8_t len) {
+    static const uint8_t table[16] = {
+        0x00, 0x07, 0x0e, 0x09, 0x1c, 0x1b, 0x12, 0x15,
+        0x38, 0x3f, 0x36, 0x31, 0x24, 0x23, 0x2a, 0x2d,
+    };
+    uint8_t crc = 0;
+    while (len--) {
+        crc ^= *buf++;
+        crc = (crc << 4) ^ table[crc >> 4];
+        crc = (crc << 4) ^ table[crc >> 4];
+    }
+    return crc;
+}
+
+#endif
@@ -0,0 +1,278 @@
+#define _XOPEN_SOURCE 700
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <libgen.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/i2c-dev.h>
+#include <linux/i2c.h>
+#include "i2c_regmap.h"
+#include "i2c_transport.h"
+
+i2c_stats_t i2c_stats;
+void (*i2c_unstick)(void);
+
+static int fd = -1;
+static const char *device = I2C_DEVICE;
+static uint8_t address = I2C_ADDRESS;
+static int failed_in_row;
+
+static struct {                                         // register file behind i2c_open_mock()
+    bool on;
+    uint8_t regs[0x100];
+    uint8_t (*frame)[FRAME_SIZE];
+    uint32_t *due_ms;
+    int count, next;
+    struct timespec start;
+} mock;
+
+// Adapter
+
+int i2c_open(const char *dev, uint8_t addr) {
+    device = dev;
+    address = addr;
+    fd = open(device, O_RDWR);
+    if (fd < 0) {
+        perror("Failed to open the bus");
+        return -1;
+    }
+    return 0;
+}
+
+void i2c_close(void) {
+    if (fd >= 0)
+        close(fd);
+    fd = -1;
+    free(mock.frame);
+    free(mock.due_ms);
+    mock.frame = NULL;
+    mock.due_ms = NULL;
+    mock.on = false;
+}
+
+bool i2c_mocked(void) {
+    return mock.on;
+}
+
+static int sysfs_write(const char *dir, const char *file, const char *value) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s", dir, file);
+    int f = open(path, O_WRONLY);
+    if (f < 0)
+        return -1;
+    int ret = write(f, value, strlen(value)) < 0 ? -1 : 0;
+    close(f);
+    return ret;
+}
+
+// Unbind and bind the adapter's platform driver: the controller comes back reset with its
+// pins in I2C mode again. Between the two, i2c_unstick can clock out a target holding SDA.
+static void recover(void) {
+    char link[PATH_MAX], adapter[PATH_MAX], bound[PATH_MAX + 8], driver[PATH_MAX];
+
+    i2c_stats.recoveries++;
+    failed_in_row = 0;
+    close(fd);
+    fd = -1;
+
+    const char *node = strrchr(device, '/');
+    snprintf(link, sizeof(link), "/sys/class/i2c-dev/%s/device/..", node ? node + 1 : device);
+    snprintf(bound, sizeof(bound), "%s/driver", link);
+    if (!realpath(link, adapter) || !realpath(bound, driver)) {
+        fprintf(stderr, "I2C recovery: no adapter driver for %s, reopening only\n", device);
+    } else {
+        const char *name = basename(adapter);
+        fprintf(stderr, "I2C recovery: rebinding %s\n", name);
+        if (sysfs_write(driver, "unbind", name) < 0)
+            perror("I2C recovery unbind");
+        else {
+            if (i2c_unstick)
+                i2c_unstick();
+            if (sysfs_write(driver, "bind", name) < 0)
+                perror("I2C recovery bind");
+        }
+    }
+    for (int i = 0; i < 100 && fd < 0; i++) {           // udev recreates the node
+        fd = open(device, O_RDWR);
+        if (fd < 0) nanosleep(&(struct timespec){ 0, 10000000 }, NULL);
+    }
+    if (fd < 0)
+        perror("Failed to reopen the bus");
+}
+
+// NACK while the MCU holds SCL for a wake pulse, arbitration or timeout on a noisy bus:
+// all worth a retry. A wrong device or address is not.
+_Static_assert(I2C_BACKOFF_MS * ((1 << (I2C_TRIES - 1)) - 1) > WAKE_PULSE_MS &&
+               I2C_BACKOFF_MAX_MS >= I2C_BACKOFF_MS << (I2C_TRIES - 2),
+               "retries must outlast a wake pulse, or a read that hits one counts toward recovery");
+static bool transient(int err) {
+    return err == ENXIO || err == EREMOTEIO || err == EIO || err == ETIMEDOUT || err == EAGAIN;
+}
+
+static int transfer(struct i2c_msg *msgs, int nmsgs) {
+    struct i2c_rdwr_ioctl_data rdwr_data = { .msgs = msgs, .nmsgs = nmsgs };
+    int backoff_ms = I2C_BACKOFF_MS, err = EBADF;
+
+    i2c_stats.transfers++;
+    for (int attempt = 0; attempt < I2C_TRIES; attempt++) {
+        if (attempt) {
+            i2c_stats.retries++;
+            nanosleep(&(struct timespec){ 0, backoff_ms * 1000000L }, NULL);
+            if (backoff_ms < I2C_BACKOFF_MAX_MS) backoff_ms *= 2;
+        }
+        if (fd < 0 && (fd = open(device, O_RDWR)) < 0) {
+            err = errno;
+            continue;
+        }
+        if (ioctl(fd, I2C_RDWR, &rdwr_data) >= 0) {
+            failed_in_row = 0;
+            return 0;
+        }
+        err = errno;
+        if (!transient(err))
+            break;
+    }
+    i2c_stats.failures++;
+    fprintf(stderr, "I2C transfer to 0x%02x failed: %s\n", address, strerror(err));
+    if (++failed_in_row >= I2C_RECOVER_AFTER)
+        recover();
+    return -1;
+}
+
+// Mock
+
+static uint32_t mock_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((now.tv_sec - mock.start.tv_sec) * 1000000000LL + now.tv_nsec - mock.start.tv_nsec) / 1000000;
+}
+
+static int mock_due(void) {
+    int n = 0;
+    uint32_t ms = mock_ms();
+    while (mock.next + n < mock.count && mock.due_ms[mock.next + n] <= ms) n++;
+    return n;
+}
+
+int i2c_open_mock(const char *frames) {
+    char line[1024];
+    int size = 0;
+    FILE *f = fopen(frames, "r");
+    if (!f) {
+        perror("fopen frames");
+        return -1;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        char *p = strchr(line, '#');
+        if (p) *p = '\0';
+        char *end;
+        double ms = strtod(line, &end);
+        if (end == line)
+            continue;
+        if (mock.count == size) {
+            size = size ? 2 * size : 256;
+            void *fr = realloc(mock.frame, size * sizeof(*mock.frame));
+            void *due = realloc(mock.due_ms, size * sizeof(*mock.due_ms));
+            if (fr) mock.frame = fr;
+            if (due) mock.due_ms = due;
+            if (!fr || !due) {
+                perror("realloc");
+                fclose(f);
+                return -1;
+            }
+        }
+        uint8_t *fr = mock.frame[mock.count];
+        int n = 0;
+        for (p = end; n < FRAME_SIZE; n++, p = end) {
+            unsigned long byte = strtoul(p, &end, 16);
+            if (end == p) break;
+            fr[n] = byte;
+        }
+        int len = n ? FRAME_LEN(fr[0] & STATUS_COUNT) : FRAME_SIZE;
+        if (n == len - 1)                               // hand-written: CRC left out
+            fr[n++] = crc8(fr, len - 1);
+        if (n != len || len > FRAME_SIZE) {
+            fprintf(stderr, "%s: frame %d has %d bytes, not %d\n", frames, mock.count + 1, n, len);
+            continue;
+        }
+        if (!(fr[0] & STATUS_COUNT) && !fr[1])          // the status byte would not report it, never read
+            continue;
+        mock.due_ms[mock.count++] = ms;
+    }
+    fclose(f);
+    mock.on = true;
+    clock_gettime(CLOCK_MONOTONIC, &mock.start);
+    printf("I2C mock: %d frames from %s\n", mock.count, frames);
+    return 0;
+}
+
+int i2c_mock_wait(const struct timespec *timeout) {
+    if (mock.next >= mock.count)
+        return -1;
+    uint32_t ms = mock_ms(), wait = timeout->tv_sec * 1000 + timeout->tv_nsec / 1000000;
+    if (mock.due_ms[mock.next] <= ms)
+        return 1;
+    uint32_t left = mock.due_ms[mock.next] - ms;
+    if (left > wait) {
+        nanosleep(timeout, NULL);
+        return 0;
+    }
+    nanosleep(&(struct timespec){ left / 1000, (left % 1000) * 1000000L }, NULL);
+    return mock_due() ? 1 : 0;
+}
+
+static void mock_read(uint8_t reg, uint8_t *buf, uint16_t len) {
+    int due = mock_due();
+
+    if (reg == REG_FRAME && due) {                      // frame reads are one frame, the pointer resets
+        const uint8_t *fr = mock.frame[mock.next];
+        uint16_t size = FRAME_LEN(fr[0] & STATUS_COUNT);
+        memcpy(buf, fr, len < size ? len : size);
+        if (len >= size) mock.next++;                   // like the MCU, kept unless read up to its CRC
+        return;
+    }
+    if (reg == REG_FRAME) {                             // nothing due: the last frame again, a duplicate
+        uint8_t empty[FRAME_LEN(0)] = { 0, 0, mock.next ? mock.frame[mock.next - 1][2] : 0xff };
+        empty[FRAME_LEN(0) - 1] = crc8(empty, FRAME_LEN(0) - 1);
+        memcpy(buf, empty, len < FRAME_LEN(0) ? len : FRAME_LEN(0));
+        return;
+    }
+    mock.regs[REG_STATUS] = due ? (mock.frame[mock.next][0] & STATUS_COUNT) |
+        (mock.frame[mock.next][1] ? STATUS_QEI : 0) : 0;
+    for (uint16_t i = 0; i < len; i++)
+        buf[i] = mock.regs[(uint8_t)(reg + i)];
+}
+
+// Registers
+
+int i2c_read(uint8_t reg, uint8_t *buf, uint16_t len) {
+    if (mock.on) {
+        mock_read(reg, buf, len);
+        return 0;
+    }
+    struct i2c_msg msgs[2] = {
+        { .addr = address, .flags = 0, .len = 1, .buf = &reg },
+        { .addr = address, .flags = I2C_M_RD, .len = len, .buf = buf },
+    };
+    return transfer(msgs, 2);
+}
+
+int i2c_write(uint8_t reg, const uint8_t *buf, uint16_t len) {
+    uint8_t msg[1 + 0x100] = { reg };
+
+    if (len > 0x100 - reg)
+        return -1;
+    if (mock.on) {
+        memcpy(&mock.regs[reg], buf, len);
+        return 0;
+    }
+    memcpy(&msg[1], buf, len);
+    struct i2c_msg msgs[1] = {
+        { .addr = address, .flags = 0, .len = 1 + len, .buf = msg },
+    };
+    return transfer(msgs, 1);
+}
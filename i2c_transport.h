@@ -0,0 +1,42 @@
+#ifndef I2C_TRANSPORT_H
+#define I2C_TRANSPORT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+// Register access to the MSPM0 target for 1104-volumio. The adapter stays open, so a
+// frame read is one I2C_RDWR ioctl. Failed transfers are retried with a doubling
+// backoff; after I2C_RECOVER_AFTER failed transfers in a row the adapter driver is
+// unbound and bound again, which resets the controller and its pin mux.
+//
+// i2c_open_mock() replaces the bus with a register file fed from a frames file,
+// one frame per line: the ms after start at which the frame is ready, then its
+// FRAME_LEN() bytes in hex, the CRC may be left out. mcu-sim -w records such a file.
+
+#define I2C_DEVICE      "/dev/i2c-1"
+#define I2C_ADDRESS     0x77                            // the MCU's address strap, 0x70..0x77
+#define I2C_TRIES       4                               // attempts per transfer
+#define I2C_BACKOFF_MS  2                               // first retry, doubles up to I2C_BACKOFF_MAX_MS
+#define I2C_BACKOFF_MAX_MS 8
+#define I2C_RECOVER_AFTER 3                             // failed transfers before the adapter is reset
+
+typedef struct {
+    uint32_t transfers, retries, failures, recoveries;
+} i2c_stats_t;
+
+extern i2c_stats_t i2c_stats;
+extern void (*i2c_unstick)(void);                       // optional, runs while the adapter is unbound
+
+int i2c_open(const char *device, uint8_t address);
+int i2c_open_mock(const char *frames);
+void i2c_close(void);
+bool i2c_mocked(void);
+
+int i2c_read(uint8_t reg, uint8_t *buf, uint16_t len);  // register pointer write, repeated start, read
+int i2c_write(uint8_t reg, const uint8_t *buf, uint16_t len);
+
+// Mock only: 1 when the next frame is due, like an IRQ edge; 0 on timeout, -1 past the last frame
+int i2c_mock_wait(const struct timespec *timeout);
+
+#endif
@@ -0,0 +1,372 @@
+// sudo apt install -y libcjson-dev
+// gcc -Wall -Wextra -O2 -o ir-learn ir-learn.c ir_decoder.c i2c_transport.c -lcjson
+// ./ir-learn [-d /dev/i2c-N] [-a i2c_address] [-f trace.txt] [-w trace.txt] [-s section] [-o keymap.json] KEY_NAME...
+//
+// Learns remote keys. For each KEY_NAME the MCU captures one frame of raw widths
+// (REG_LEARN), the firmware decoder names protocol and scancode, and with -s the keys
+// are added to the keymap as a new section, one entry per line.
+// -f takes the frames from an ir-replay trace instead of the MCU, -w appends every
+// capture to a trace. Frames no decoder accepts print their timing clusters, which is
+// where a new ir_protocols[] entry starts.
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <signal.h>
+#include <cjson/cJSON.h>
+#include "keycode_lookup.h"
+#include "i2c_regmap.h"
+#include "i2c_transport.h"
+#include "ir_decoder.h"
+
+#define KEYMAP_FILE "myir.keymap.json"
+#define MAX_KEYS 64
+#define LEARN_TIMEOUT_MS 10000
+#define CLUSTER_TOLERANCE 20		// % around a cluster's mean
+
+const char *ir_proto_names[IR_PROTO_COUNT] = {
+    [IR_PROTO_NONE] = "unknown",
+    [IR_PROTO_RC5] = "RC5", [IR_PROTO_SIRC] = "SIRC", [IR_PROTO_NEC] = "NEC",
+    [IR_PROTO_RC6] = "RC6", [IR_PROTO_SAMSUNG] = "SAMSUNG", [IR_PROTO_JVC] = "JVC",
+};
+
+typedef struct {
+    const char *name;
+    uint32_t scancode;
+    uint8_t proto;
+} learned_t;
+
+learned_t learned[MAX_KEYS];
+int learned_count = 0;
+volatile sig_atomic_t interrupted = 0;
+
+// Only flags the stop: capture_mcu() takes the MCU out of learn mode on its way out
+void handle_signal(int sig) {
+    (void)sig;
+    interrupted = 1;
+}
+
+int write_register(uint8_t reg, uint8_t value) {
+    return i2c_write(reg, &value, 1);
+}
+
+// FRAME_SIZE bytes per transfer, longer blocks in pieces
+int read_block(uint8_t reg, uint8_t *buf, uint16_t len) {
+    for (uint16_t off = 0; off < len; off += FRAME_SIZE) {
+        if (i2c_read(reg + off, buf + off, len - off < FRAME_SIZE ? len - off : FRAME_SIZE) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+// One frame from the MCU, widths in us. Returns the number of widths, 0 if no frame came
+// within LEARN_TIMEOUT_MS, -1 if the MCU could not be reached or SIGINT/SIGTERM came.
+// Every way out clears REG_LEARN, a MCU left in learn mode does not decode IR
+int capture_mcu(uint16_t *us, int max) {
+    learn_t learn;
+    struct timespec poll = { 0, 50 * 1000000 };
+
+    if (write_register(REG_LEARN, 1) < 0)
+        return -1;
+    for (int waited = 0; waited < LEARN_TIMEOUT_MS && !interrupted; waited += 50) {
+        nanosleep(&poll, NULL);
+        if (read_block(REG_LEARN, (uint8_t *)&learn, 2) < 0)
+            break;
+        if (learn.state == LEARN_DONE) {
+            if (read_block(REG_LEARN, (uint8_t *)&learn, sizeof(learn)) < 0)
+                break;
+            write_register(REG_LEARN, 0);
+            int n = learn.count < max ? learn.count : max;
+            for (int i = 0; i < n; i++)
+                us[i] = learn.width[i] > 0x7fff ? 0xffff : learn.width[i] * 2;
+            return n;
+        }
+        if (waited + 50 >= LEARN_TIMEOUT_MS) {
+            write_register(REG_LEARN, 0);
+            fprintf(stderr, "no IR frame within %d s\n", LEARN_TIMEOUT_MS / 1000);
+            return 0;
+        }
+    }
+    write_register(REG_LEARN, 0);                       // best effort after a read error
+    return -1;
+}
+
+// Next frame of an ir-replay trace, widths in us. Returns the number of widths, -1 at the end
+int capture_trace(FILE *f, uint16_t *us, int max) {
+    char buf[2048];
+
+    while (fgets(buf, sizeof(buf), f)) {
+        char *p = strchr(buf, '#');
+        if (p) *p = '\0';
+        p = strchr(buf, ':');
+        p = p ? p + 1 : buf;
+
+        int n = 0;
+        char *end;
+        for (long w = strtol(p, &end, 10); end != p && n < max; w = strtol(p, &end, 10)) {
+            us[n++] = w > 0xffff ? 0xffff : w;
+            p = end;
+        }
+        if (n) return n;
+    }
+    return -1;
+}
+
+// Feed widths through the firmware decoder, first valid frame wins
+uint8_t decode(const uint16_t *us, int n, uint32_t *code) {
+    ir_decoder_t d;
+    uint8_t proto;
+
+    ir_reset(&d);
+    ir_edge(&d, 0xffff);                                // leading edge
+    for (int i = 0; i < n; i++) {
+        uint16_t ticks = US(us[i]);
+        if (d.pending != IR_PROTO_NONE && ticks > ir_gap(d.pending) && (proto = ir_finish(&d, code)))
+            return proto;
+        ir_edge(&d, ticks);
+    }
+    return d.pending != IR_PROTO_NONE ? ir_finish(&d, code) : IR_PROTO_NONE;
+}
+
+int cmp_u16(const void *a, const void *b) {
+    return *(const uint16_t *)a - *(const uint16_t *)b;
+}
+
+// Distinct widths within CLUSTER_TOLERANCE of each other, shortest first
+void print_clusters(const uint16_t *us, int n) {
+    uint16_t sorted[LEARN_DEPTH * 4];
+    if (n > (int)(sizeof(sorted) / sizeof(sorted[0]))) n = sizeof(sorted) / sizeof(sorted[0]);
+    memcpy(sorted, us, n * sizeof(us[0]));
+    qsort(sorted, n, sizeof(sorted[0]), cmp_u16);
+
+    printf("  timing clusters:");
+    for (int i = 0; i < n; ) {
+        uint32_t sum = 0;
+        int j = i;
+        while (j < n && sorted[j] * 100 <= (uint32_t)sorted[i] * (100 + 2 * CLUSTER_TOLERANCE))
+            sum += sorted[j++];
+        printf(" %u us x%d", sum / (j - i), j - i);
+        i = j;
+    }
+    printf("\n");
+}
+
+// Protocol every learned key came in, IR_PROTO_NONE if they differ
+uint8_t learned_protocol(void) {
+    for (int i = 1; i < learned_count; i++) {
+        if (learned[i].proto != learned[0].proto)
+            return IR_PROTO_NONE;
+    }
+    return learned_count ? learned[0].proto : IR_PROTO_NONE;
+}
+
+// Just inside the braces of Config "protocols", or of Config when it has no "protocols"
+// yet (*have false). NULL without a Config object.
+char *protocols_at(char *text, bool *have) {
+    char *key = strstr(text, "\"protocols\"");
+    *have = key != NULL;
+    if (!key)
+        key = strstr(text, "\"Config\"");
+    char *brace = key ? strchr(key, '{') : NULL;
+    return brace ? brace + 1 : NULL;
+}
+
+// Append the section before the closing brace, keeping the file's own formatting, and
+// name its protocol in Config "protocols" so the daemon routes only that remote to it
+int write_section(const char *filename, const char *section) {
+    FILE *f = fopen(filename, "r");
+    if (!f) {
+        perror("fopen keymap");
+        return -1;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    rewind(f);
+    char *text = malloc(size + 1);
+    if (!text || fread(text, 1, size, f) != (size_t)size) {
+        fprintf(stderr, "failed to read %s\n", filename);
+        fclose(f);
+        free(text);
+        return -1;
+    }
+    fclose(f);
+    text[size] = '\0';
+
+    cJSON *root = cJSON_Parse(text);
+    char *close = strrchr(text, '}');
+    if (!root || !close) {
+        fprintf(stderr, "%s is not a JSON object\n", filename);
+        cJSON_Delete(root);
+        free(text);
+        return -1;
+    }
+    if (cJSON_GetObjectItem(root, section)) {
+        fprintf(stderr, "section \"%s\" already in %s, pick another name\n", section, filename);
+        cJSON_Delete(root);
+        free(text);
+        return -1;
+    }
+    cJSON_Delete(root);
+
+    char *last = close;                                 // end of the previous section
+    while (last > text && (last[-1] == ' ' || last[-1] == '\t' || last[-1] == '\r' || last[-1] == '\n'))
+        last--;
+    const char *eol = strstr(text, "\r\n") ? "\r\n" : "\n";
+    uint8_t proto = learned_protocol();
+    bool have = false;
+    char *at = proto ? protocols_at(text, &have) : NULL;
+    if (at > last)
+        at = NULL;
+
+    // Built in memory and parsed back before the keymap is replaced
+    char *json = NULL;
+    size_t len = 0;
+    FILE *m = open_memstream(&json, &len);
+    if (!m) {
+        perror("open_memstream");
+        free(text);
+        return -1;
+    }
+    const char *from = text;
+    if (at) {
+        const char *next = at + strspn(at, " \t\r\n");
+        bool empty = *next == '}';
+        fwrite(text, 1, at - text, m);
+        if (have)
+            fprintf(m, " \"%s\": \"%s\"%s", section, ir_proto_names[proto], empty ? " " : ",");
+        else
+            fprintf(m, "%s    \"protocols\": { \"%s\": \"%s\" }%s", eol, section, ir_proto_names[proto], empty ? eol : ",");
+        from = at;
+    }
+    fwrite(from, 1, last - from, m);
+    fprintf(m, ",%s  \"%s\": [%s", eol, section, eol);
+    for (int i = 0; i < learned_count; i++)
+        fprintf(m, "    { \"scancode\": \"0x%04x\", \"keycode\": \"%s\", \"keycommand\": \"\" }%s%s",
+            learned[i].scancode, learned[i].name, i + 1 < learned_count ? "," : "", eol);
+    fprintf(m, "  ]%s%s", eol, close);
+    fclose(m);
+
+    root = cJSON_Parse(json);
+    bool named = cJSON_GetObjectItem(cJSON_GetObjectItem(cJSON_GetObjectItem(root, "Config"), "protocols"), section) != NULL;
+    bool valid = root && cJSON_IsArray(cJSON_GetObjectItem(root, section));
+    cJSON_Delete(root);
+    if (!valid) {
+        fprintf(stderr, "could not add section \"%s\" to %s, left unchanged\n", section, filename);
+        free(json);
+        free(text);
+        return -1;
+    }
+
+    f = fopen(filename, "w");
+    if (!f || fwrite(json, 1, len, f) != len) {
+        perror("write keymap");
+        if (f) fclose(f);
+        free(json);
+        free(text);
+        return -1;
+    }
+    fclose(f);
+    printf("Wrote %d keys to section '%s' of %s\n", learned_count, section, filename);
+    if (named)
+        printf("Config \"protocols\": section '%s' answers %s remotes only\n", section, ir_proto_names[proto]);
+    else if (!proto)
+        printf("Keys came in different protocols, section '%s' answers any remote\n", section);
+    else
+        printf("No Config object in %s, section '%s' answers any remote\n", filename, section);
+    free(json);
+    free(text);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    const char *trace_in = NULL, *trace_out = NULL, *section = NULL, *keymap = KEYMAP_FILE, *device = I2C_DEVICE;
+    uint8_t address = I2C_ADDRESS;
+    FILE *in = NULL, *out = NULL;
+    uint16_t us[LEARN_DEPTH * 4];
+    int opt;
+
+    while ((opt = getopt(argc, argv, "d:a:f:w:s:o:")) != -1) {
+        switch (opt) {
+            case 'd': device = optarg; break;
+            case 'a': address = strtoul(optarg, NULL, 0); break;
+            case 'f': trace_in = optarg; break;
+            case 'w': trace_out = optarg; break;
+            case 's': section = optarg; break;
+            case 'o': keymap = optarg; break;
+            default:
+                fprintf(stderr, "usage: %s [-d /dev/i2c-N] [-a i2c_address] [-f trace.txt] [-w trace.txt] "
+                    "[-s section] [-o keymap.json] KEY_NAME...\n", argv[0]);
+                return 1;
+        }
+    }
+    if (optind >= argc && !trace_in) {
+        fprintf(stderr, "no key names given\n");
+        return 1;
+    }
+    if (trace_in && !(in = fopen(trace_in, "r"))) {
+        perror("fopen trace");
+        return 1;
+    }
+    if (trace_out && !(out = fopen(trace_out, "a"))) {
+        perror("fopen trace");
+        return 1;
+    }
+    if (!in && i2c_open(device, address) < 0)          // same retries and bus recovery as the daemon
+        return 1;
+    if (!in) {
+        struct sigaction stop = { .sa_handler = handle_signal };   // no SA_RESTART, the poll sleep ends early
+        sigemptyset(&stop.sa_mask);
+        sigaction(SIGINT, &stop, NULL);
+        sigaction(SIGTERM, &stop, NULL);
+    }
+
+    for (int k = optind; (k < argc || (in && optind == argc)) && learned_count < MAX_KEYS; k++) {
+        const char *name = k < argc ? argv[k] : NULL;
+        if (name && resolve_keycode(name) <= 0)
+            fprintf(stderr, "warning: %s is not a known key name, the daemon will skip it\n", name);
+        if (!in) {
+            printf("Press %s on the remote...\n", name);
+            fflush(stdout);
+        }
+
+        int n = in ? capture_trace(in, us, sizeof(us) / sizeof(us[0])) : capture_mcu(us, LEARN_DEPTH);
+        if (n < 0) {
+            if (in) break;
+            fprintf(stderr, interrupted ? "Interrupted, learn mode off\n" : "MCU not reachable, giving up\n");
+            if (out) fclose(out);
+            i2c_close();
+            return 1;
+        }
+        if (n == 0) {
+            k--;                                        // timed out, ask again
+            continue;
+        }
+
+        uint32_t code = 0;
+        uint8_t proto = decode(us, n, &code);
+        printf("%s: %d widths, %s", name ? name : "frame", n, ir_proto_names[proto]);
+        if (proto) printf(" scancode 0x%06x\n", code);
+        else {
+            printf("\n");
+            print_clusters(us, n);
+        }
+        if (out) {
+            if (proto) fprintf(out, "0x%06x:", code);
+            for (int i = 0; i < n; i++) fprintf(out, " %u", us[i]);
+            fprintf(out, "%s%s\n", name ? "  # " : "", name ? name : "");
+        }
+        if (proto && name)
+            learned[learned_count++] = (learned_t){ name, code, proto };
+    }
+
+    if (in) fclose(in);
+    else i2c_close();
+    if (out) fclose(out);
+    if (section && learned_count)
+        return write_section(keymap, section) < 0;
+    return 0;
+}
@@ -0,0 +1,164 @@
+// gcc -Wall -Wextra -O2 -o ir-replay ir-replay.c ir_decoder.c
+// ./ir-replay [-j jitter_us] [-n noise_percent] [-l loops] [-q] [-c] trace.txt
+//
+// Replays IR pulse traces through the firmware decoder on the host.
+// Trace format, one frame per line, '#' starts a comment:
+//   0x000116: 13500 1125 1125 2250 ...
+// Widths are us between falling edges, the leading edge is implied.
+// The optional hex prefix is the expected scancode for that frame.
+// -c exits 1 unless every frame with an expected scancode decoded to it and
+// every frame without one, a truncated frame or noise, decoded to nothing;
+// traces/check.sh runs it over the per-protocol fixtures.
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include "ir_decoder.h"
+
+#define MAX_FRAMES 1024
+#define MAX_EDGES 128
+
+typedef struct {
+    uint32_t expect;
+    int has_expect;
+    int n;
+    uint16_t us[MAX_EDGES];
+} frame_t;
+
+frame_t frames[MAX_FRAMES];
+int frame_count = 0;
+
+int load_trace(const char *filename) {
+    char buf[2048];
+    FILE *f = fopen(filename, "r");
+    if (!f) {
+        perror("fopen trace");
+        return -1;
+    }
+    while (fgets(buf, sizeof(buf), f) && frame_count < MAX_FRAMES) {
+        char *p = strchr(buf, '#');
+        if (p) *p = '\0';
+        frame_t *fr = &frames[frame_count];
+        fr->n = fr->has_expect = 0;
+
+        p = strchr(buf, ':');
+        if (p) {
+            fr->expect = strtoul(buf, NULL, 16);
+            fr->has_expect = 1;
+            p++;
+        } else p = buf;
+
+        char *end;
+        for (long w = strtol(p, &end, 10); end != p && fr->n < MAX_EDGES; w = strtol(p, &end, 10)) {
+            fr->us[fr->n++] = w > 0xffff ? 0xffff : w;
+            p = end;
+        }
+        if (fr->n) frame_count++;
+    }
+    fclose(f);
+    return frame_count;
+}
+
+uint16_t to_ticks(uint16_t us, int jitter) {
+    int w = us;
+    if (jitter) w += rand() % (2 * jitter + 1) - jitter;
+    if (w < 2) w = 2;
+    return w / 2 > 0xffff ? 0xffff : w / 2;
+}
+
+int main(int argc, char *argv[]) {
+    int jitter = 0, noise = 0, loops = 1, quiet = 0, check = 0, opt;
+    while ((opt = getopt(argc, argv, "j:n:l:qc")) != -1) {
+        switch (opt) {
+            case 'j': jitter = atoi(optarg); break;
+            case 'n': noise = atoi(optarg); break;
+            case 'l': loops = atoi(optarg); break;
+            case 'q': quiet = 1; break;
+            case 'c': check = 1; break;
+            default:
+                fprintf(stderr, "usage: %s [-j jitter_us] [-n noise_percent] [-l loops] [-q] [-c] trace\n", argv[0]);
+                return 1;
+        }
+    }
+    if (optind >= argc) {
+        fprintf(stderr, "no trace file given\n");
+        return 1;
+    }
+    if (load_trace(argv[optind]) <= 0) {
+        fprintf(stderr, "no frames in %s\n", argv[optind]);
+        return 1;
+    }
+    srand(1);
+
+    ir_decoder_t d;
+    ir_reset(&d);
+    uint16_t ticks[2 * MAX_EDGES + 1];
+    uint32_t code;
+    uint64_t ns = 0, edges = 0;
+    int expected = 0, correct = 0, decoded = 0, wrong = 0, spurious = 0;
+
+    for (int l = 0; l < loops; l++) {
+        for (int i = 0; i < frame_count; i++) {
+            frame_t *fr = &frames[i];
+            int n = 0;
+            ticks[n++] = 0xffff;                        // leading edge
+            for (int e = 0; e < fr->n; e++) {
+                uint16_t t = to_ticks(fr->us[e], jitter);
+                if (noise && rand() % 100 < noise && t > 2) {   // glitch splits the interval
+                    uint16_t cut = 1 + rand() % (t - 1);
+                    ticks[n++] = cut;
+                    t -= cut;
+                }
+                ticks[n++] = t;
+            }
+
+            uint32_t first = 0;
+            int got = 0;
+            struct timespec t0, t1;
+            clock_gettime(CLOCK_MONOTONIC, &t0);
+            for (int e = 0; e < n; e++) {
+                if (d.pending != IR_PROTO_NONE && ticks[e] > ir_gap(d.pending)) {
+                    if (ir_finish(&d, &code) && !got++) first = code;
+                }
+                ir_edge(&d, ticks[e]);
+            }
+            if (d.pending != IR_PROTO_NONE && ir_finish(&d, &code) && !got++)
+                first = code;
+            ir_reset(&d);                               // idle timeout between frames
+            clock_gettime(CLOCK_MONOTONIC, &t1);
+            ns += (t1.tv_sec - t0.tv_sec) * 1000000000ULL + t1.tv_nsec - t0.tv_nsec;
+            edges += n;
+
+            if (got) decoded++;
+            if (fr->has_expect) {
+                expected++;
+                if (got && first == fr->expect) correct++;
+                else if (got) wrong++;
+            } else if (got) spurious++;
+            if (!quiet && l == 0) {
+                if (got) printf("frame %d: 0x%06x%s\n", i, first,
+                    fr->has_expect && first != fr->expect ? " (wrong)" : "");
+                else printf("frame %d: no decode\n", i);
+            }
+        }
+    }
+
+    printf("frames %d, decoded %d", frame_count * loops, decoded);
+    if (expected)
+        printf(", decode rate %.1f%%, error rate %.1f%% (%d wrong, %d missed)",
+            100.0 * correct / expected, 100.0 * (expected - correct) / expected,
+            wrong, expected - correct - wrong);
+    if (spurious)
+        printf(", %d decoded without an expected scancode", spurious);
+    printf("\n%llu edges, %.1f ns/edge on host\n", (unsigned long long)edges, edges ? (double)ns / edges : 0);
+    if (check && (!expected || correct != expected || spurious)) {
+        fprintf(stderr, "%s: %d of %d frames not decoded to their scancode, %d decoded that should not\n",
+            argv[optind], expected - correct, expected, spurious);
+        return 1;
+    }
+    return 0;
+}
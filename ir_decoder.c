@@ -0,0 +1,188 @@
+#include "ir_decoder.h"
+
+const ir_protocol_t ir_protocols[IR_PROTO_COUNT] = {
+    [IR_PROTO_RC5] = {                                  // T = 889 us, S1 S2 toggle, 5 addr, 6 cmd
+        .encoding = IR_BIPHASE, .bits = 14,
+        .unit = US(889), .recip = 65536 / US(889), .tol = US(200),
+        .first = 3, .edge_bit = 1, .init = 0x3000, .gap = US(4000),
+    },
+    [IR_PROTO_SIRC] = {                                 // 12 bit, last bit has no closing edge
+        .encoding = IR_PULSE_DISTANCE, .bits = 11,
+        .zero_min = US(900), .zero_max = US(1500), .one_min = US(1500), .one_max = US(2100),
+        .gap = US(3000),
+    },
+    [IR_PROTO_NEC] = {
+        .encoding = IR_PULSE_DISTANCE, .bits = 32,
+        .zero_min = US(875), .zero_max = US(1375), .one_min = US(2000), .one_max = US(2500),
+        .gap = US(3000),
+    },
+    [IR_PROTO_RC6] = {                                  // mode 0, T = 444 us, start 3 mode trailer 8 addr 8 cmd
+        .encoding = IR_BIPHASE, .bits = 21,
+        .unit = US(444), .recip = 65536 / US(444), .tol = US(150),
+        .first = 0, .wide = 4, .edge_bit = 0, .init = 0x1fffff, .gap = US(3000),
+    },
+    [IR_PROTO_SAMSUNG] = {                              // 4.5 ms leader, NEC bits
+        .encoding = IR_PULSE_DISTANCE, .bits = 32,
+        .zero_min = US(875), .zero_max = US(1375), .one_min = US(2000), .one_max = US(2500),
+        .gap = US(3000),
+    },
+    [IR_PROTO_JVC] = {                                  // 8.4 ms leader, 8 addr 8 cmd
+        .encoding = IR_PULSE_DISTANCE, .bits = 16,
+        .zero_min = US(800), .zero_max = US(1300), .one_min = US(1800), .one_max = US(2400),
+        .gap = US(3000),
+    },
+};
+
+// Leader interval to protocol, one lookup regardless of protocol count
+#define IR_BIN(us)      (US(us) >> 6)                   // 128 us bins
+#define IR_BINS         (IR_BIN(14625) + 1)
+
+static const uint8_t ir_leader[IR_BINS] = {
+    [IR_BIN(1500)  ... IR_BIN(2100)]  = IR_PROTO_RC5,                   // 1.78 ms
+    [IR_BIN(2800)  ... IR_BIN(3200)]  = IR_PROTO_SIRC,                  // 3.0 ms
+    [IR_BIN(3400)  ... IR_BIN(3800)]  = IR_PROTO_RC6,                   // 3.56 ms
+    [IR_BIN(8200)  ... IR_BIN(9800)]  = IR_PROTO_SAMSUNG,               // 9.0 ms
+    [IR_BIN(10125) ... IR_BIN(11900)] = IR_PROTO_NEC | IR_REPEAT,       // 11.25 ms
+    [IR_BIN(12000) ... IR_BIN(13000)] = IR_PROTO_JVC,                   // 12.6 ms
+    [IR_BIN(13100) ... IR_BIN(14625)] = IR_PROTO_NEC,                   // 13.5 ms
+};
+
+void ir_reset(ir_decoder_t *d) {
+    d->count = 0;
+    d->state = IR_IDLE;
+    d->pending = IR_PROTO_NONE;
+}
+
+uint16_t ir_gap(uint8_t proto) {
+    return proto && proto < IR_PROTO_COUNT ? ir_protocols[proto].gap : IR_GAP_IDLE;
+}
+
+// Bi-phase: round interval to half bits, then a falling edge in mid bit sets that bit
+static uint8_t ir_biphase(ir_decoder_t *d, const ir_protocol_t *p, uint16_t width) {
+    uint8_t n = ((uint32_t)width * p->recip + 0x8000) >> 16;
+    int32_t err = (int32_t)width - n * p->unit;
+
+    if (n == 0 || n > 6 || err > p->tol || err < -p->tol)
+        return 0;                                       // Invalid pulse
+
+    uint8_t pos = d->count += n;
+    if (p->wide && pos >= 2 * p->wide) {
+        if (pos < 2 * p->wide + 4) {
+            if (pos != 2 * p->wide + 2) return 1;       // inside double width bit
+            pos = 2 * p->wide + 1;
+        } else pos -= 2;
+    }
+    if (!(pos & 1)) return 1;                           // bit boundary
+
+    uint8_t bit = pos >> 1;
+    if (bit >= p->bits) return 0;
+    if (p->edge_bit) d->data |= 1UL << (p->bits - 1 - bit);
+    else d->data &= ~(1UL << (p->bits - 1 - bit));
+    return 1;
+}
+
+uint8_t ir_edge(ir_decoder_t *d, uint16_t pulse_width) {
+    const ir_protocol_t *p;
+
+    switch (d->state) {
+        case IR_IDLE:
+            d->state = IR_START;
+            return IR_PROTO_NONE;
+
+        case IR_START: {
+            uint8_t lead = pulse_width < US(14625) ? ir_leader[pulse_width >> 6] : IR_PROTO_NONE;
+            if (lead & IR_REPEAT) {                     // repeat, reuse last frame
+                d->proto = lead & ~IR_REPEAT;
+                d->data = d->last;
+                d->state = IR_IDLE;
+                return d->pending = d->proto;
+            }
+            if (lead == IR_PROTO_NONE) break;
+            p = &ir_protocols[lead];
+            d->proto = lead;
+            d->state = IR_DATA;
+            if (p->encoding == IR_BIPHASE) {
+                d->count = p->first;
+                d->data = p->init;
+                return d->pending = lead;               // arm gap timeout from the leader on
+            }
+            d->count = 0;
+            d->data = 0;
+            return IR_PROTO_NONE;
+        }
+
+        case IR_DATA:
+            p = &ir_protocols[d->proto];
+            if (p->encoding == IR_BIPHASE) {
+                if (ir_biphase(d, p, pulse_width)) return d->pending = d->proto;
+            } else if (d->count < 32) {
+                if (pulse_width > p->zero_min && pulse_width <= p->zero_max) {
+                    d->count++;
+                    return d->pending = d->proto;
+                } else if (pulse_width > p->one_min && pulse_width <= p->one_max) {
+                    d->data |= (1UL << d->count++);
+                    return d->pending = d->proto;
+                }
+            }
+            break;                                      // Invalid pulse
+
+        default:
+            break;
+    }
+    ir_reset(d);
+    return IR_PROTO_NONE;
+}
+
+// Scancode layout matches event bytes 1..3
+uint8_t ir_finish(ir_decoder_t *d, uint32_t *code) {
+    uint8_t proto = d->pending;
+    const ir_protocol_t *p = &ir_protocols[proto];
+    uint32_t data = d->data;
+    uint8_t count = d->count;
+    uint8_t repeat = (d->state == IR_IDLE);
+
+    ir_reset(d);
+    d->repeat = repeat;
+    if (proto == IR_PROTO_NONE) return IR_PROTO_NONE;
+    if (p->encoding == IR_PULSE_DISTANCE && !repeat && count < p->bits)
+        return IR_PROTO_NONE;                           // too short
+    if (p->encoding == IR_BIPHASE && count < 2 * p->bits - 3 + (p->wide ? 2 : 0))
+        return IR_PROTO_NONE;                           // ended before the middle of the next-to-last bit
+
+    switch (proto) {
+        case IR_PROTO_RC5:
+            *code = ((data >> 6) & 0x1f) << 8 | (data & 0x3f);
+            break;
+
+        case IR_PROTO_SIRC:
+            *code = ((data >> 7) & 0x1f) << 16 | ((data >> 12) & 0xff) << 8 | (data & 0x7f);
+            break;
+
+        case IR_PROTO_NEC:
+            if ((data & 0x00ff00ff) + ((data & 0xff00ff00) >> 8) == 0x00ff00ff)          // nec
+                *code = ((data & 0x00ff0000) >> 16) + ((data & 0x000000ff) << 8);
+            else if ((data & 0x00ff0000) + ((data & 0xff000000) >> 8) == 0x00ff0000)     // necx
+                *code = ((data & 0x00ff0000) >> 16) + ((data & 0x0000ffff) << 8);
+            else return IR_PROTO_NONE;                                                  // error
+            d->last = data;
+            break;
+
+        case IR_PROTO_RC6:
+            if ((data >> 17) & 0x7) return IR_PROTO_NONE;                               // mode 0 only
+            *code = data & 0xffff;
+            break;
+
+        case IR_PROTO_SAMSUNG:
+            if (((data >> 16) & 0xff) + (data >> 24) != 0xff) return IR_PROTO_NONE;     // ~cmd
+            *code = (data & 0xff) << 8 | ((data >> 16) & 0xff);
+            break;
+
+        case IR_PROTO_JVC:
+            *code = (data & 0xff) << 8 | ((data >> 8) & 0xff);
+            break;
+
+        default:
+            return IR_PROTO_NONE;
+    }
+    return proto;
+}
@@ -0,0 +1,65 @@
+#ifndef IR_DECODER_H
+#define IR_DECODER_H
+
+#include <stdint.h>
+
+// Pure table-driven IR decoder, no DriverLib calls.
+// Pulse widths are CAPTURE_0 ticks (2 us) between falling edges.
+
+#define US(us)          ((us) / 2)                      // microseconds to CAPTURE_0 ticks
+
+enum IR_State {
+    IR_IDLE,
+    IR_START,
+    IR_DATA,
+};
+
+enum IR_Proto {
+    IR_PROTO_NONE,
+    IR_PROTO_RC5,
+    IR_PROTO_SIRC,
+    IR_PROTO_NEC,
+    IR_PROTO_RC6,
+    IR_PROTO_SAMSUNG,
+    IR_PROTO_JVC,
+    IR_PROTO_COUNT,
+};
+
+enum IR_Encoding {
+    IR_PULSE_DISTANCE,                                  // mark + space per bit, LSB first
+    IR_BIPHASE,                                         // Manchester, MSB first
+};
+
+#define IR_REPEAT       0x80                            // leader table: repeat frame of protocol
+#define IR_GAP_IDLE     60000                           // release, 120 ms
+
+typedef struct {
+    uint8_t encoding;
+    uint8_t bits;                                       // frame length, minimum for pulse distance
+    uint16_t zero_min, zero_max;                        // pulse distance: 0-bit interval window
+    uint16_t one_min, one_max;                          // pulse distance: 1-bit interval window
+    uint16_t unit, recip, tol;                          // bi-phase: half bit, 65536 / unit, tolerance
+    uint8_t first;                                      // bi-phase: half-bit position after leader
+    uint8_t wide;                                       // bi-phase: double width bit index, 0 none
+    uint8_t edge_bit;                                   // bi-phase: value of bit with mid-bit falling edge
+    uint32_t init;                                      // bi-phase: bits known after leader
+    uint16_t gap;                                       // end of frame timeout
+} ir_protocol_t;
+
+typedef struct {
+    uint8_t state, count;                               // count: bits (pulse distance), half bits (bi-phase)
+    uint8_t proto;                                      // protocol of frame in progress
+    uint8_t pending;                                    // protocol waiting for its gap timeout
+    uint8_t repeat;                                     // last ir_finish was a repeat code, not a frame
+    uint32_t data;
+    uint32_t last;                                      // last complete NEC frame, for repeats
+} ir_decoder_t;
+
+extern const ir_protocol_t ir_protocols[IR_PROTO_COUNT];
+
+void ir_reset(ir_decoder_t *d);
+uint8_t ir_edge(ir_decoder_t *d, uint16_t width);       // returns protocol to (re)arm gap timeout for
+uint8_t ir_finish(ir_decoder_t *d, uint32_t *code);     // on gap timeout, protocol if code is valid
+uint16_t ir_gap(uint8_t proto);
+
+#endif
@@ -1,495 +1,794 @@
+#ifndef KEYCODE_LOOKUP_H
+#define KEYCODE_LOOKUP_H
+
+#include <stdlib.h>
+#include <string.h>
+
+// Linux input keycodes by name for the keymap, and names by keycode for logging.
+// keycode_names[] must stay in strcmp() order (LC_ALL=C sort): resolve_keycode() is a
+// binary search over it, nine compares for the whole table. Names mapped to 0 are not
+// supported and resolve to 0.
+
+#define KEYCODE_MAX 521
+
+typedef struct { const char *name; int code; } keycode_name_t;
+
+static const keycode_name_t keycode_names[] = {
+  { "BTN_MOUSE", 0x110 },
+  { "KEY_0", 11 },
+  { "KEY_1", 2 },
+  { "KEY_102ND", 86 },
+  { "KEY_10CHANNELSDOWN", 0 },
+  { "KEY_10CHANNELSUP", 0 },
+  { "KEY_2", 3 },
+  { "KEY_3", 4 },
+  { "KEY_3D_MODE", 0 },
+  { "KEY_4", 5 },
+  { "KEY_5", 6 },
+  { "KEY_6", 7 },
+  { "KEY_7", 8 },
+  { "KEY_8", 9 },
+  { "KEY_9", 10 },
+  { "KEY_A", 30 },
+  { "KEY_AB", 0 },
+  { "KEY_ADDRESSBOOK", 0 },
+  { "KEY_AGAIN", 129 },
+  { "KEY_ALS_TOGGLE", 0 },
+  { "KEY_ALTERASE", 222 },
+  { "KEY_ANGLE", 0 },
+  { "KEY_APOSTROPHE", 40 },
+  { "KEY_APPSELECT", 0 },
+  { "KEY_ARCHIVE", 0 },
+  { "KEY_ASPECT_RATIO", 0 },
+  { "KEY_ASSISTANT", 0 },
+  { "KEY_ATTENDANT_OFF", 0 },
+  { "KEY_ATTENDANT_ON", 0 },
+  { "KEY_ATTENDANT_TOGGLE", 0 },
+  { "KEY_AUDIO", 0x188 },
+  { "KEY_AUDIO_DESC", 0 },
+  { "KEY_AUX", 0 },
+  { "KEY_B", 48 },
+  { "KEY_BACK", 158 },
+  { "KEY_BACKSLASH", 43 },
+  { "KEY_BACKSPACE", 14 },
+  { "KEY_BASSBOOST", 209 },
+  { "KEY_BATTERY", 236 },
+  { "KEY_BLUE", 0x191 },
+  { "KEY_BLUETOOTH", 237 },
+  { "KEY_BOOKMARKS", 156 },
+  { "KEY_BREAK", 0 },
+  { "KEY_BRIGHTNESSDOWN", 224 },
+  { "KEY_BRIGHTNESSUP", 225 },
+  { "KEY_BRIGHTNESS_AUTO", 244 },
+  { "KEY_BRIGHTNESS_CYCLE", 243 },
+  { "KEY_BRIGHTNESS_MAX", 0 },
+  { "KEY_BRIGHTNESS_MIN", 0 },
+  { "KEY_BRL_DOT1", 0 },
+  { "KEY_BRL_DOT10", 0 },
+  { "KEY_BRL_DOT2", 0 },
+  { "KEY_BRL_DOT3", 0 },
+  { "KEY_BRL_DOT4", 0 },
+  { "KEY_BRL_DOT5", 0 },
+  { "KEY_BRL_DOT6", 0 },
+  { "KEY_BRL_DOT7", 0 },
+  { "KEY_BRL_DOT8", 0 },
+  { "KEY_BRL_DOT9", 0 },
+  { "KEY_BUTTONCONFIG", 0 },
+  { "KEY_C", 46 },
+  { "KEY_CALC", 140 },
+  { "KEY_CALENDAR", 0 },
+  { "KEY_CAMERA", 212 },
+  { "KEY_CAMERA_DOWN", 0 },
+  { "KEY_CAMERA_FOCUS", 0 },
+  { "KEY_CAMERA_LEFT", 0 },
+  { "KEY_CAMERA_RIGHT", 0 },
+  { "KEY_CAMERA_UP", 0 },
+  { "KEY_CAMERA_ZOOMIN", 0 },
+  { "KEY_CAMERA_ZOOMOUT", 0 },
+  { "KEY_CANCEL", 223 },
+  { "KEY_CAPSLOCK", 58 },
+  { "KEY_CD", 0 },
+  { "KEY_CHANNEL", 0 },
+  { "KEY_CHANNELDOWN", 0x193 },
+  { "KEY_CHANNELUP", 0x192 },
+  { "KEY_CHAT", 216 },
+  { "KEY_CLEAR", 0x163 },
+  { "KEY_CLOSE", 206 },
+  { "KEY_CLOSECD", 160 },
+  { "KEY_COFFEE", 152 },
+  { "KEY_COMMA", 51 },
+  { "KEY_COMPOSE", 127 },
+  { "KEY_COMPUTER", 157 },
+  { "KEY_CONFIG", 171 },
+  { "KEY_CONNECT", 218 },
+  { "KEY_CONTEXT_MENU", 0 },
+  { "KEY_CONTROLPANEL", 0 },
+  { "KEY_COPY", 133 },
+  { "KEY_CUT", 137 },
+  { "KEY_CYCLEWINDOWS", 154 },
+  { "KEY_D", 32 },
+  { "KEY_DASHBOARD", 204 },
+  { "KEY_DATA", 0 },
+  { "KEY_DATABASE", 0 },
+  { "KEY_DELETE", 111 },
+  { "KEY_DELETEFILE", 146 },
+  { "KEY_DEL_EOL", 0 },
+  { "KEY_DEL_EOS", 0 },
+  { "KEY_DEL_LINE", 0 },
+  { "KEY_DIGITS", 0 },
+  { "KEY_DIRECTORY", 0 },
+  { "KEY_DISPLAYTOGGLE", 0 },
+  { "KEY_DISPLAY_OFF", 245 },
+  { "KEY_DOCUMENTS", 235 },
+  { "KEY_DOLLAR", 0 },
+  { "KEY_DOT", 52 },
+  { "KEY_DOWN", 108 },
+  { "KEY_DVD", 0 },
+  { "KEY_E", 18 },
+  { "KEY_EDIT", 176 },
+  { "KEY_EDITOR", 0 },
+  { "KEY_EJECTCD", 161 },
+  { "KEY_EJECTCLOSECD", 162 },
+  { "KEY_EMAIL", 215 },
+  { "KEY_EMOJI_PICKER", 0 },
+  { "KEY_END", 107 },
+  { "KEY_ENTER", 28 },
+  { "KEY_EPG", 0x16d },
+  { "KEY_EQUAL", 13 },
+  { "KEY_ESC", 1 },
+  { "KEY_EURO", 0 },
+  { "KEY_EXIT", 174 },
+  { "KEY_F", 33 },
+  { "KEY_F1", 59 },
+  { "KEY_F10", 68 },
+  { "KEY_F11", 87 },
+  { "KEY_F12", 88 },
+  { "KEY_F13", 183 },
+  { "KEY_F14", 184 },
+  { "KEY_F15", 185 },
+  { "KEY_F16", 186 },
+  { "KEY_F17", 187 },
+  { "KEY_F18", 188 },
+  { "KEY_F19", 189 },
+  { "KEY_F2", 60 },
+  { "KEY_F20", 190 },
+  { "KEY_F21", 191 },
+  { "KEY_F22", 192 },
+  { "KEY_F23", 193 },
+  { "KEY_F24", 194 },
+  { "KEY_F3", 61 },
+  { "KEY_F4", 62 },
+  { "KEY_F5", 63 },
+  { "KEY_F6", 64 },
+  { "KEY_F7", 65 },
+  { "KEY_F8", 66 },
+  { "KEY_F9", 67 },
+  { "KEY_FASTFORWARD", 208 },
+  { "KEY_FASTREVERSE", 0 },
+  { "KEY_FAVORITES", 0 },
+  { "KEY_FILE", 144 },
+  { "KEY_FINANCE", 219 },
+  { "KEY_FIND", 136 },
+  { "KEY_FIRST", 0 },
+  { "KEY_FN", 0 },
+  { "KEY_FN_1", 0 },
+  { "KEY_FN_2", 0 },
+  { "KEY_FN_B", 0 },
+  { "KEY_FN_D", 0 },
+  { "KEY_FN_E", 0 },
+  { "KEY_FN_ESC", 0 },
+  { "KEY_FN_F", 0 },
+  { "KEY_FN_F1", 0 },
+  { "KEY_FN_F10", 0 },
+  { "KEY_FN_F11", 0 },
+  { "KEY_FN_F12", 0 },
+  { "KEY_FN_F2", 0 },
+  { "KEY_FN_F3", 0 },
+  { "KEY_FN_F4", 0 },
+  { "KEY_FN_F5", 0 },
+  { "KEY_FN_F6", 0 },
+  { "KEY_FN_F7", 0 },
+  { "KEY_FN_F8", 0 },
+  { "KEY_FN_F9", 0 },
+  { "KEY_FN_RIGHT_SHIFT", 0 },
+  { "KEY_FN_S", 0 },
+  { "KEY_FORWARD", 159 },
+  { "KEY_FORWARDMAIL", 233 },
+  { "KEY_FRAMEBACK", 0 },
+  { "KEY_FRAMEFORWARD", 0 },
+  { "KEY_FRONT", 132 },
+  { "KEY_FULL_SCREEN", 0 },
+  { "KEY_G", 34 },
+  { "KEY_GAMES", 0 },
+  { "KEY_GOTO", 0 },
+  { "KEY_GRAPHICSEDITOR", 0 },
+  { "KEY_GRAVE", 41 },
+  { "KEY_GREEN", 0x18f },
+  { "KEY_H", 35 },
+  { "KEY_HANGEUL", 122 },
+  { "KEY_HANGUP_PHONE", 0 },
+  { "KEY_HANJA", 123 },
+  { "KEY_HELP", 138 },
+  { "KEY_HENKAN", 92 },
+  { "KEY_HIRAGANA", 91 },
+  { "KEY_HOME", 102 },
+  { "KEY_HOMEPAGE", 172 },
+  { "KEY_HP", 211 },
+  { "KEY_I", 23 },
+  { "KEY_IMAGES", 0 },
+  { "KEY_INFO", 0 },
+  { "KEY_INSERT", 110 },
+  { "KEY_INS_LINE", 0 },
+  { "KEY_ISO", 170 },
+  { "KEY_J", 36 },
+  { "KEY_JOURNAL", 0 },
+  { "KEY_K", 37 },
+  { "KEY_KATAKANA", 90 },
+  { "KEY_KATAKANAHIRAGANA", 93 },
+  { "KEY_KBDILLUMDOWN", 229 },
+  { "KEY_KBDILLUMTOGGLE", 228 },
+  { "KEY_KBDILLUMUP", 230 },
+  { "KEY_KBDINPUTASSIST_ACCEPT", 0 },
+  { "KEY_KBDINPUTASSIST_CANCEL", 0 },
+  { "KEY_KBDINPUTASSIST_NEXT", 0 },
+  { "KEY_KBDINPUTASSIST_NEXTGROUP", 0 },
+  { "KEY_KBDINPUTASSIST_PREV", 0 },
+  { "KEY_KBDINPUTASSIST_PREVGROUP", 0 },
+  { "KEY_KBD_LAYOUT_NEXT", 0 },
+  { "KEY_KBD_LCD_MENU1", 0 },
+  { "KEY_KBD_LCD_MENU2", 0 },
+  { "KEY_KBD_LCD_MENU3", 0 },
+  { "KEY_KBD_LCD_MENU4", 0 },
+  { "KEY_KBD_LCD_MENU5", 0 },
+  { "KEY_KEYBOARD", 0 },
+  { "KEY_KP0", 82 },
+  { "KEY_KP1", 79 },
+  { "KEY_KP2", 80 },
+  { "KEY_KP3", 81 },
+  { "KEY_KP4", 75 },
+  { "KEY_KP5", 76 },
+  { "KEY_KP6", 77 },
+  { "KEY_KP7", 71 },
+  { "KEY_KP8", 72 },
+  { "KEY_KP9", 73 },
+  { "KEY_KPASTERISK", 55 },
+  { "KEY_KPCOMMA", 121 },
+  { "KEY_KPDOT", 83 },
+  { "KEY_KPENTER", 96 },
+  { "KEY_KPEQUAL", 117 },
+  { "KEY_KPJPCOMMA", 95 },
+  { "KEY_KPLEFTPAREN", 179 },
+  { "KEY_KPMINUS", 74 },
+  { "KEY_KPPLUS", 78 },
+  { "KEY_KPPLUSMINUS", 118 },
+  { "KEY_KPRIGHTPAREN", 180 },
+  { "KEY_KPSLASH", 98 },
+  { "KEY_L", 38 },
+  { "KEY_LANGUAGE", 0 },
+  { "KEY_LAST", 0 },
+  { "KEY_LEFT", 105 },
+  { "KEY_LEFTALT", 56 },
+  { "KEY_LEFTBRACE", 26 },
+  { "KEY_LEFTCTRL", 29 },
+  { "KEY_LEFTMETA", 125 },
+  { "KEY_LEFTSHIFT", 42 },
+  { "KEY_LEFT_DOWN", 0 },
+  { "KEY_LEFT_UP", 0 },
+  { "KEY_LIGHTS_TOGGLE", 0 },
+  { "KEY_LINEFEED", 101 },
+  { "KEY_LIST", 0 },
+  { "KEY_LOGOFF", 0 },
+  { "KEY_M", 50 },
+  { "KEY_MACRO", 112 },
+  { "KEY_MACRO1", 0 },
+  { "KEY_MACRO10", 0 },
+  { "KEY_MACRO11", 0 },
+  { "KEY_MACRO12", 0 },
+  { "KEY_MACRO13", 0 },
+  { "KEY_MACRO14", 0 },
+  { "KEY_MACRO15", 0 },
+  { "KEY_MACRO16", 0 },
+  { "KEY_MACRO17", 0 },
+  { "KEY_MACRO18", 0 },
+  { "KEY_MACRO19", 0 },
+  { "KEY_MACRO2", 0 },
+  { "KEY_MACRO20", 0 },
+  { "KEY_MACRO21", 0 },
+  { "KEY_MACRO22", 0 },
+  { "KEY_MACRO23", 0 },
+  { "KEY_MACRO24", 0 },
+  { "KEY_MACRO25", 0 },
+  { "KEY_MACRO26", 0 },
+  { "KEY_MACRO27", 0 },
+  { "KEY_MACRO28", 0 },
+  { "KEY_MACRO29", 0 },
+  { "KEY_MACRO3", 0 },
+  { "KEY_MACRO30", 0 },
+  { "KEY_MACRO4", 0 },
+  { "KEY_MACRO5", 0 },
+  { "KEY_MACRO6", 0 },
+  { "KEY_MACRO7", 0 },
+  { "KEY_MACRO8", 0 },
+  { "KEY_MACRO9", 0 },
+  { "KEY_MACRO_PRESET1", 0 },
+  { "KEY_MACRO_PRESET2", 0 },
+  { "KEY_MACRO_PRESET3", 0 },
+  { "KEY_MACRO_PRESET_CYCLE", 0 },
+  { "KEY_MACRO_RECORD_START", 0 },
+  { "KEY_MACRO_RECORD_STOP", 0 },
+  { "KEY_MAIL", 155 },
+  { "KEY_MAX", 0 },
+  { "KEY_MEDIA", 226 },
+  { "KEY_MEDIA_REPEAT", 0 },
+  { "KEY_MEDIA_TOP_MENU", 0 },
+  { "KEY_MEMO", 0 },
+  { "KEY_MENU", 139 },
+  { "KEY_MESSENGER", 0 },
+  { "KEY_MHP", 0 },
+  { "KEY_MICMUTE", 248 },
+  { "KEY_MINUS", 12 },
+  { "KEY_MODE", 0 },
+  { "KEY_MOVE", 175 },
+  { "KEY_MP3", 0 },
+  { "KEY_MSDOS", 151 },
+  { "KEY_MUHENKAN", 94 },
+  { "KEY_MUTE", 113 },
+  { "KEY_N", 49 },
+  { "KEY_NEW", 181 },
+  { "KEY_NEWS", 0 },
+  { "KEY_NEXT", 0x197 },
+  { "KEY_NEXTSONG", 163 },
+  { "KEY_NEXT_FAVORITE", 0 },
+  { "KEY_NOTIFICATION_CENTER", 0 },
+  { "KEY_NUMERIC_0", 0x200 },
+  { "KEY_NUMERIC_1", 0x201 },
+  { "KEY_NUMERIC_11", 0 },
+  { "KEY_NUMERIC_12", 0 },
+  { "KEY_NUMERIC_2", 0x202 },
+  { "KEY_NUMERIC_3", 0x203 },
+  { "KEY_NUMERIC_4", 0x204 },
+  { "KEY_NUMERIC_5", 0x205 },
+  { "KEY_NUMERIC_6", 0x206 },
+  { "KEY_NUMERIC_7", 0x207 },
+  { "KEY_NUMERIC_8", 0x208 },
+  { "KEY_NUMERIC_9", 0x209 },
+  { "KEY_NUMERIC_A", 0 },
+  { "KEY_NUMERIC_B", 0 },
+  { "KEY_NUMERIC_C", 0 },
+  { "KEY_NUMERIC_D", 0 },
+  { "KEY_NUMERIC_POUND", 0 },
+  { "KEY_NUMERIC_STAR", 0 },
+  { "KEY_NUMLOCK", 69 },
+  { "KEY_O", 24 },
+  { "KEY_OK", 0x160 },
+  { "KEY_ONSCREEN_KEYBOARD", 0 },
+  { "KEY_OPEN", 134 },
+  { "KEY_OPTION", 0 },
+  { "KEY_P", 25 },
+  { "KEY_PAGEDOWN", 109 },
+  { "KEY_PAGEUP", 104 },
+  { "KEY_PASTE", 135 },
+  { "KEY_PAUSE", 119 },
+  { "KEY_PAUSECD", 201 },
+  { "KEY_PAUSE_RECORD", 0 },
+  { "KEY_PC", 0 },
+  { "KEY_PHONE", 169 },
+  { "KEY_PICKUP_PHONE", 0 },
+  { "KEY_PLAY", 207 },
+  { "KEY_PLAYCD", 200 },
+  { "KEY_PLAYER", 0 },
+  { "KEY_PLAYPAUSE", 164 },
+  { "KEY_POWER", 116 },
+  { "KEY_POWER2", 356 },
+  { "KEY_PRESENTATION", 0 },
+  { "KEY_PREVIOUS", 0x19c },
+  { "KEY_PREVIOUSSONG", 165 },
+  { "KEY_PRINT", 210 },
+  { "KEY_PRIVACY_SCREEN_TOGGLE", 0 },
+  { "KEY_PROG1", 148 },
+  { "KEY_PROG2", 149 },
+  { "KEY_PROG3", 202 },
+  { "KEY_PROG4", 203 },
+  { "KEY_PROGRAM", 0 },
+  { "KEY_PROPS", 130 },
+  { "KEY_PVR", 0 },
+  { "KEY_Q", 16 },
+  { "KEY_QUESTION", 214 },
+  { "KEY_R", 19 },
+  { "KEY_RADIO", 0 },
+  { "KEY_RECORD", 167 },
+  { "KEY_RED", 0x18e },
+  { "KEY_REDO", 182 },
+  { "KEY_REFRESH", 173 },
+  { "KEY_REPLY", 232 },
+  { "KEY_RESERVED", 0 },
+  { "KEY_RESTART", 0 },
+  { "KEY_REWIND", 168 },
+  { "KEY_RFKILL", 247 },
+  { "KEY_RIGHT", 106 },
+  { "KEY_RIGHTALT", 100 },
+  { "KEY_RIGHTBRACE", 27 },
+  { "KEY_RIGHTCTRL", 97 },
+  { "KEY_RIGHTMETA", 126 },
+  { "KEY_RIGHTSHIFT", 54 },
+  { "KEY_RIGHT_DOWN", 0 },
+  { "KEY_RIGHT_UP", 0 },
+  { "KEY_RO", 89 },
+  { "KEY_ROOT_MENU", 0 },
+  { "KEY_ROTATE_DISPLAY", 153 },
+  { "KEY_ROTATE_LOCK_TOGGLE", 0 },
+  { "KEY_S", 31 },
+  { "KEY_SAT", 0 },
+  { "KEY_SAT2", 0 },
+  { "KEY_SAVE", 234 },
+  { "KEY_SCALE", 120 },
+  { "KEY_SCREENSAVER", 0 },
+  { "KEY_SCROLLDOWN", 178 },
+  { "KEY_SCROLLLOCK", 70 },
+  { "KEY_SCROLLUP", 177 },
+  { "KEY_SEARCH", 217 },
+  { "KEY_SELECT", 0 },
+  { "KEY_SELECTIVE_SCREENSHOT", 0 },
+  { "KEY_SEMICOLON", 39 },
+  { "KEY_SEND", 231 },
+  { "KEY_SENDFILE", 145 },
+  { "KEY_SETUP", 141 },
+  { "KEY_SHOP", 221 },
+  { "KEY_SHUFFLE", 0 },
+  { "KEY_SLASH", 53 },
+  { "KEY_SLEEP", 142 },
+  { "KEY_SLOW", 0 },
+  { "KEY_SLOWREVERSE", 0 },
+  { "KEY_SOUND", 213 },
+  { "KEY_SPACE", 57 },
+  { "KEY_SPELLCHECK", 0 },
+  { "KEY_SPORT", 220 },
+  { "KEY_SPREADSHEET", 0 },
+  { "KEY_STOP", 128 },
+  { "KEY_STOPCD", 166 },
+  { "KEY_STOP_RECORD", 0 },
+  { "KEY_SUBTITLE", 0x172 },
+  { "KEY_SUSPEND", 205 },
+  { "KEY_SWITCHVIDEOMODE", 227 },
+  { "KEY_SYSRQ", 99 },
+  { "KEY_T", 20 },
+  { "KEY_TAB", 15 },
+  { "KEY_TAPE", 0 },
+  { "KEY_TASKMANAGER", 0 },
+  { "KEY_TEEN", 0 },
+  { "KEY_TEXT", 0 },
+  { "KEY_TIME", 0 },
+  { "KEY_TITLE", 0 },
+  { "KEY_TOUCHPAD_OFF", 0 },
+  { "KEY_TOUCHPAD_ON", 0 },
+  { "KEY_TOUCHPAD_TOGGLE", 0 },
+  { "KEY_TUNER", 0 },
+  { "KEY_TV", 0 },
+  { "KEY_TV2", 0 },
+  { "KEY_TWEN", 0 },
+  { "KEY_U", 22 },
+  { "KEY_UNDO", 131 },
+  { "KEY_UNKNOWN", 240 },
+  { "KEY_UNMUTE", 0 },
+  { "KEY_UP", 103 },
+  { "KEY_UWB", 239 },
+  { "KEY_V", 47 },
+  { "KEY_VCR", 0 },
+  { "KEY_VCR2", 0 },
+  { "KEY_VENDOR", 0 },
+  { "KEY_VIDEO", 0 },
+  { "KEY_VIDEOPHONE", 0 },
+  { "KEY_VIDEO_NEXT", 241 },
+  { "KEY_VIDEO_PREV", 242 },
+  { "KEY_VOD", 0 },
+  { "KEY_VOICECOMMAND", 0 },
+  { "KEY_VOICEMAIL", 0 },
+  { "KEY_VOLUMEDOWN", 114 },
+  { "KEY_VOLUMEUP", 115 },
+  { "KEY_W", 17 },
+  { "KEY_WAKEUP", 143 },
+  { "KEY_WLAN", 238 },
+  { "KEY_WORDPROCESSOR", 0 },
+  { "KEY_WPS_BUTTON", 0 },
+  { "KEY_WWAN", 246 },
+  { "KEY_WWW", 150 },
+  { "KEY_X", 45 },
+  { "KEY_XFER", 147 },
+  { "KEY_Y", 21 },
+  { "KEY_YELLOW", 0x190 },
+  { "KEY_YEN", 124 },
+  { "KEY_Z", 44 },
+  { "KEY_ZENKAKUHANKAKU", 85 },
+  { "KEY_ZOOMIN", 0 },
+  { "KEY_ZOOMOUT", 0 },
+  { "KEY_ZOOMRESET", 0 },
+};
+
+static const char *const keycode_by_code[KEYCODE_MAX + 1] = {
+  [1] = "KEY_ESC",
+  [2] = "KEY_1",
+  [3] = "KEY_2",
+  [4] = "KEY_3",
+  [5] = "KEY_4",
+  [6] = "KEY_5",
+  [7] = "KEY_6",
+  [8] = "KEY_7",
+  [9] = "KEY_8",
+  [10] = "KEY_9",
+  [11] = "KEY_0",
+  [12] = "KEY_MINUS",
+  [13] = "KEY_EQUAL",
+  [14] = "KEY_BACKSPACE",
+  [15] = "KEY_TAB",
+  [16] = "KEY_Q",
+  [17] = "KEY_W",
+  [18] = "KEY_E",
+  [19] = "KEY_R",
+  [20] = "KEY_T",
+  [21] = "KEY_Y",
+  [22] = "KEY_U",
+  [23] = "KEY_I",
+  [24] = "KEY_O",
+  [25] = "KEY_P",
+  [26] = "KEY_LEFTBRACE",
+  [27] = "KEY_RIGHTBRACE",
+  [28] = "KEY_ENTER",
+  [29] = "KEY_LEFTCTRL",
+  [30] = "KEY_A",
+  [31] = "KEY_S",
+  [32] = "KEY_D",
+  [33] = "KEY_F",
+  [34] = "KEY_G",
+  [35] = "KEY_H",
+  [36] = "KEY_J",
+  [37] = "KEY_K",
+  [38] = "KEY_L",
+  [39] = "KEY_SEMICOLON",
+  [40] = "KEY_APOSTROPHE",
+  [41] = "KEY_GRAVE",
+  [42] = "KEY_LEFTSHIFT",
+  [43] = "KEY_BACKSLASH",
+  [44] = "KEY_Z",
+  [45] = "KEY_X",
+  [46] = "KEY_C",
+  [47] = "KEY_V",
+  [48] = "KEY_B",
+  [49] = "KEY_N",
+  [50] = "KEY_M",
+  [51] = "KEY_COMMA",
+  [52] = "KEY_DOT",
+  [53] = "KEY_SLASH",
+  [54] = "KEY_RIGHTSHIFT",
+  [55] = "KEY_KPASTERISK",
+  [56] = "KEY_LEFTALT",
+  [57] = "KEY_SPACE",
+  [58] = "KEY_CAPSLOCK",
+  [59] = "KEY_F1",
+  [60] = "KEY_F2",
+  [61] = "KEY_F3",
+  [62] = "KEY_F4",
+  [63] = "KEY_F5",
+  [64] = "KEY_F6",
+  [65] = "KEY_F7",
+  [66] = "KEY_F8",
+  [67] = "KEY_F9",
+  [68] = "KEY_F10",
+  [69] = "KEY_NUMLOCK",
+  [70] = "KEY_SCROLLLOCK",
+  [71] = "KEY_KP7",
+  [72] = "KEY_KP8",
+  [73] = "KEY_KP9",
+  [74] = "KEY_KPMINUS",
+  [75] = "KEY_KP4",
+  [76] = "KEY_KP5",
+  [77] = "KEY_KP6",
+  [78] = "KEY_KPPLUS",
+  [79] = "KEY_KP1",
+  [80] = "KEY_KP2",
+  [81] = "KEY_KP3",
+  [82] = "KEY_KP0",
+  [83] = "KEY_KPDOT",
+  [85] = "KEY_ZENKAKUHANKAKU",
+  [86] = "KEY_102ND",
+  [87] = "KEY_F11",
+  [88] = "KEY_F12",
+  [89] = "KEY_RO",
+  [90] = "KEY_KATAKANA",
+  [91] = "KEY_HIRAGANA",
+  [92] = "KEY_HENKAN",
+  [93] = "KEY_KATAKANAHIRAGANA",
+  [94] = "KEY_MUHENKAN",
+  [95] = "KEY_KPJPCOMMA",
+  [96] = "KEY_KPENTER",
+  [97] = "KEY_RIGHTCTRL",
+  [98] = "KEY_KPSLASH",
+  [99] = "KEY_SYSRQ",
+  [100] = "KEY_RIGHTALT",
+  [101] = "KEY_LINEFEED",
+  [102] = "KEY_HOME",
+  [103] = "KEY_UP",
+  [104] = "KEY_PAGEUP",
+  [105] = "KEY_LEFT",
+  [106] = "KEY_RIGHT",
+  [107] = "KEY_END",
+  [108] = "KEY_DOWN",
+  [109] = "KEY_PAGEDOWN",
+  [110] = "KEY_INSERT",
+  [111] = "KEY_DELETE",
+  [112] = "KEY_MACRO",
+  [113] = "KEY_MUTE",
+  [114] = "KEY_VOLUMEDOWN",
+  [115] = "KEY_VOLUMEUP",
+  [116] = "KEY_POWER",
+  [117] = "KEY_KPEQUAL",
+  [118] = "KEY_KPPLUSMINUS",
+  [119] = "KEY_PAUSE",
+  [120] = "KEY_SCALE",
+  [121] = "KEY_KPCOMMA",
+  [122] = "KEY_HANGEUL",
+  [123] = "KEY_HANJA",
+  [124] = "KEY_YEN",
+  [125] = "KEY_LEFTMETA",
+  [126] = "KEY_RIGHTMETA",
+  [127] = "KEY_COMPOSE",
+  [128] = "KEY_STOP",
+  [129] = "KEY_AGAIN",
+  [130] = "KEY_PROPS",
+  [131] = "KEY_UNDO",
+  [132] = "KEY_FRONT",
+  [133] = "KEY_COPY",
+  [134] = "KEY_OPEN",
+  [135] = "KEY_PASTE",
+  [136] = "KEY_FIND",
+  [137] = "KEY_CUT",
+  [138] = "KEY_HELP",
+  [139] = "KEY_MENU",
+  [140] = "KEY_CALC",
+  [141] = "KEY_SETUP",
+  [142] = "KEY_SLEEP",
+  [143] = "KEY_WAKEUP",
+  [144] = "KEY_FILE",
+  [145] = "KEY_SENDFILE",
+  [146] = "KEY_DELETEFILE",
+  [147] = "KEY_XFER",
+  [148] = "KEY_PROG1",
+  [149] = "KEY_PROG2",
+  [150] = "KEY_WWW",
+  [151] = "KEY_MSDOS",
+  [152] = "KEY_COFFEE",
+  [153] = "KEY_ROTATE_DISPLAY",
+  [154] = "KEY_CYCLEWINDOWS",
+  [155] = "KEY_MAIL",
+  [156] = "KEY_BOOKMARKS",
+  [157] = "KEY_COMPUTER",
+  [158] = "KEY_BACK",
+  [159] = "KEY_FORWARD",
+  [160] = "KEY_CLOSECD",
+  [161] = "KEY_EJECTCD",
+  [162] = "KEY_EJECTCLOSECD",
+  [163] = "KEY_NEXTSONG",
+  [164] = "KEY_PLAYPAUSE",
+  [165] = "KEY_PREVIOUSSONG",
+  [166] = "KEY_STOPCD",
+  [167] = "KEY_RECORD",
+  [168] = "KEY_REWIND",
+  [169] = "KEY_PHONE",
+  [170] = "KEY_ISO",
+  [171] = "KEY_CONFIG",
+  [172] = "KEY_HOMEPAGE",
+  [173] = "KEY_REFRESH",
+  [174] = "KEY_EXIT",
+  [175] = "KEY_MOVE",
+  [176] = "KEY_EDIT",
+  [177] = "KEY_SCROLLUP",
+  [178] = "KEY_SCROLLDOWN",
+  [179] = "KEY_KPLEFTPAREN",
+  [180] = "KEY_KPRIGHTPAREN",
+  [181] = "KEY_NEW",
+  [182] = "KEY_REDO",
+  [183] = "KEY_F13",
+  [184] = "KEY_F14",
+  [185] = "KEY_F15",
+  [186] = "KEY_F16",
+  [187] = "KEY_F17",
+  [188] = "KEY_F18",
+  [189] = "KEY_F19",
+  [190] = "KEY_F20",
+  [191] = "KEY_F21",
+  [192] = "KEY_F22",
+  [193] = "KEY_F23",
+  [194] = "KEY_F24",
+  [200] = "KEY_PLAYCD",
+  [201] = "KEY_PAUSECD",
+  [202] = "KEY_PROG3",
+  [203] = "KEY_PROG4",
+  [204] = "KEY_DASHBOARD",
+  [205] = "KEY_SUSPEND",
+  [206] = "KEY_CLOSE",
+  [207] = "KEY_PLAY",
+  [208] = "KEY_FASTFORWARD",
+  [209] = "KEY_BASSBOOST",
+  [210] = "KEY_PRINT",
+  [211] = "KEY_HP",
+  [212] = "KEY_CAMERA",
+  [213] = "KEY_SOUND",
+  [214] = "KEY_QUESTION",
+  [215] = "KEY_EMAIL",
+  [216] = "KEY_CHAT",
+  [217] = "KEY_SEARCH",
+  [218] = "KEY_CONNECT",
+  [219] = "KEY_FINANCE",
+  [220] = "KEY_SPORT",
+  [221] = "KEY_SHOP",
+  [222] = "KEY_ALTERASE",
+  [223] = "KEY_CANCEL",
+  [224] = "KEY_BRIGHTNESSDOWN",
+  [225] = "KEY_BRIGHTNESSUP",
+  [226] = "KEY_MEDIA",
+  [227] = "KEY_SWITCHVIDEOMODE",
+  [228] = "KEY_KBDILLUMTOGGLE",
+  [229] = "KEY_KBDILLUMDOWN",
+  [230] = "KEY_KBDILLUMUP",
+  [231] = "KEY_SEND",
+  [232] = "KEY_REPLY",
+  [233] = "KEY_FORWARDMAIL",
+  [234] = "KEY_SAVE",
+  [235] = "KEY_DOCUMENTS",
+  [236] = "KEY_BATTERY",
+  [237] = "KEY_BLUETOOTH",
+  [238] = "KEY_WLAN",
+  [239] = "KEY_UWB",
+  [240] = "KEY_UNKNOWN",
+  [241] = "KEY_VIDEO_NEXT",
+  [242] = "KEY_VIDEO_PREV",
+  [243] = "KEY_BRIGHTNESS_CYCLE",
+  [244] = "KEY_BRIGHTNESS_AUTO",
+  [245] = "KEY_DISPLAY_OFF",
+  [246] = "KEY_WWAN",
+  [247] = "KEY_RFKILL",
+  [248] = "KEY_MICMUTE",
+  [0x110] = "BTN_MOUSE",
+  [0x160] = "KEY_OK",
+  [0x163] = "KEY_CLEAR",
+  [0x164] = "KEY_POWER2",
+  [0x16d] = "KEY_EPG",
+  [0x172] = "KEY_SUBTITLE",
+  [0x188] = "KEY_AUDIO",
+  [0x18e] = "KEY_RED",
+  [0x18f] = "KEY_GREEN",
+  [0x190] = "KEY_YELLOW",
+  [0x191] = "KEY_BLUE",
+  [0x192] = "KEY_CHANNELUP",
+  [0x193] = "KEY_CHANNELDOWN",
+  [0x197] = "KEY_NEXT",
+  [0x19c] = "KEY_PREVIOUS",
+  [0x200] = "KEY_NUMERIC_0",
+  [0x201] = "KEY_NUMERIC_1",
+  [0x202] = "KEY_NUMERIC_2",
+  [0x203] = "KEY_NUMERIC_3",
+  [0x204] = "KEY_NUMERIC_4",
+  [0x205] = "KEY_NUMERIC_5",
+  [0x206] = "KEY_NUMERIC_6",
+  [0x207] = "KEY_NUMERIC_7",
+  [0x208] = "KEY_NUMERIC_8",
+  [0x209] = "KEY_NUMERIC_9",
+};
+
+static int keycode_compare(const void *key, const void *entry) {
+  return strcmp(key, ((const keycode_name_t *)entry)->name);
+}
+
+// Keycode for a KEY_* or BTN_* name, -1 if unknown
 int resolve_keycode(const char *name) {
-  struct { const char *name; int code; } table[] = {
-    { "KEY_RESERVED", 0 },
-    { "KEY_ESC", 1 },
-    { "KEY_1", 2 },
-    { "KEY_2", 3 },
-    { "KEY_3", 4 },
-    { "KEY_4", 5 },
-    { "KEY_5", 6 },
-    { "KEY_6", 7 },
-    { "KEY_7", 8 },
-    { "KEY_8", 9 },
-    { "KEY_9", 10 },
-    { "KEY_0", 11 },
-    { "KEY_MINUS", 12 },
-    { "KEY_EQUAL", 13 },
-    { "KEY_BACKSPACE", 14 },
-    { "KEY_TAB", 15 },
-    { "KEY_Q", 16 },
-    { "KEY_W", 17 },
-    { "KEY_E", 18 },
-    { "KEY_R", 19 },
-    { "KEY_T", 20 },
-    { "KEY_Y", 21 },
-    { "KEY_U", 22 },
-    { "KEY_I", 23 },
-    { "KEY_O", 24 },
-    { "KEY_P", 25 },
-    { "KEY_LEFTBRACE", 26 },
-    { "KEY_RIGHTBRACE", 27 },
-    { "KEY_ENTER", 28 },
-    { "KEY_LEFTCTRL", 29 },
-    { "KEY_A", 30 },
-    { "KEY_S", 31 },
-    { "KEY_D", 32 },
-    { "KEY_F", 33 },
-    { "KEY_G", 34 },
-    { "KEY_H", 35 },
-    { "KEY_J", 36 },
-    { "KEY_K", 37 },
-    { "KEY_L", 38 },
-    { "KEY_SEMICOLON", 39 },
-    { "KEY_APOSTROPHE", 40 },
-    { "KEY_GRAVE", 41 },
-    { "KEY_LEFTSHIFT", 42 },
-    { "KEY_BACKSLASH", 43 },
-    { "KEY_Z", 44 },
-    { "KEY_X", 45 },
-    { "KEY_C", 46 },
-    { "KEY_V", 47 },
-    { "KEY_B", 48 },
-    { "KEY_N", 49 },
-    { "KEY_M", 50 },
-    { "KEY_COMMA", 51 },
-    { "KEY_DOT", 52 },
-    { "KEY_SLASH", 53 },
-    { "KEY_RIGHTSHIFT", 54 },
-    { "KEY_KPASTERISK", 55 },
-    { "KEY_LEFTALT", 56 },
-    { "KEY_SPACE", 57 },
-    { "KEY_CAPSLOCK", 58 },
-    { "KEY_F1", 59 },
-    { "KEY_F2", 60 },
-    { "KEY_F3", 61 },
-    { "KEY_F4", 62 },
-    { "KEY_F5", 63 },
-    { "KEY_F6", 64 },
-    { "KEY_F7", 65 },
-    { "KEY_F8", 66 },
-    { "KEY_F9", 67 },
-    { "KEY_F10", 68 },
-    { "KEY_NUMLOCK", 69 },
-    { "KEY_SCROLLLOCK", 70 },
-    { "KEY_KP7", 71 },
-    { "KEY_KP8", 72 },
-    { "KEY_KP9", 73 },
-    { "KEY_KPMINUS", 74 },
-    { "KEY_KP4", 75 },
-    { "KEY_KP5", 76 },
-    { "KEY_KP6", 77 },
-    { "KEY_KPPLUS", 78 },
-    { "KEY_KP1", 79 },
-    { "KEY_KP2", 80 },
-    { "KEY_KP3", 81 },
-    { "KEY_KP0", 82 },
-    { "KEY_KPDOT", 83 },
-    { "KEY_ZENKAKUHANKAKU", 85 },
-    { "KEY_102ND", 86 },
-    { "KEY_F11", 87 },
-    { "KEY_F12", 88 },
-    { "KEY_RO", 89 },
-    { "KEY_KATAKANA", 90 },
-    { "KEY_HIRAGANA", 91 },
-    { "KEY_HENKAN", 92 },
-    { "KEY_KATAKANAHIRAGANA", 93 },
-    { "KEY_MUHENKAN", 94 },
-    { "KEY_KPJPCOMMA", 95 },
-    { "KEY_KPENTER", 96 },
-    { "KEY_RIGHTCTRL", 97 },
-    { "KEY_KPSLASH", 98 },
-    { "KEY_SYSRQ", 99 },
-    { "KEY_RIGHTALT", 100 },
-    { "KEY_LINEFEED", 101 },
-    { "KEY_HOME", 102 },
-    { "KEY_UP", 103 },
-    { "KEY_PAGEUP", 104 },
-    { "KEY_LEFT", 105 },
-    { "KEY_RIGHT", 106 },
-    { "KEY_END", 107 },
-    { "KEY_DOWN", 108 },
-    { "KEY_PAGEDOWN", 109 },
-    { "KEY_INSERT", 110 },
-    { "KEY_DELETE", 111 },
-    { "KEY_MACRO", 112 },
-    { "KEY_MUTE", 113 },
-    { "KEY_VOLUMEDOWN", 114 },
-    { "KEY_VOLUMEUP", 115 },
-    { "KEY_POWER", 116 },
-    { "KEY_KPEQUAL", 117 },
-    { "KEY_KPPLUSMINUS", 118 },
-    { "KEY_PAUSE", 119 },
-    { "KEY_SCALE", 120 },
-    { "KEY_KPCOMMA", 121 },
-    { "KEY_HANGEUL", 122 },
-    { "KEY_HANJA", 123 },
-    { "KEY_YEN", 124 },
-    { "KEY_LEFTMETA", 125 },
-    { "KEY_RIGHTMETA", 126 },
-    { "KEY_COMPOSE", 127 },
-    { "KEY_STOP", 128 },
-    { "KEY_AGAIN", 129 },
-    { "KEY_PROPS", 130 },
-    { "KEY_UNDO", 131 },
-    { "KEY_FRONT", 132 },
-    { "KEY_COPY", 133 },
-    { "KEY_OPEN", 134 },
-    { "KEY_PASTE", 135 },
-    { "KEY_FIND", 136 },
-    { "KEY_CUT", 137 },
-    { "KEY_HELP", 138 },
-    { "KEY_MENU", 139 },
-    { "KEY_CALC", 140 },
-    { "KEY_SETUP", 141 },
-    { "KEY_SLEEP", 142 },
-    { "KEY_WAKEUP", 143 },
-    { "KEY_FILE", 144 },
-    { "KEY_SENDFILE", 145 },
-    { "KEY_DELETEFILE", 146 },
-    { "KEY_XFER", 147 },
-    { "KEY_PROG1", 148 },
-    { "KEY_PROG2", 149 },
-    { "KEY_WWW", 150 },
-    { "KEY_MSDOS", 151 },
-    { "KEY_COFFEE", 152 },
-    { "KEY_ROTATE_DISPLAY", 153 },
-    { "KEY_CYCLEWINDOWS", 154 },
-    { "KEY_MAIL", 155 },
-    { "KEY_BOOKMARKS", 156 },
-    { "KEY_COMPUTER", 157 },
-    { "KEY_BACK", 158 },
-    { "KEY_FORWARD", 159 },
-    { "KEY_CLOSECD", 160 },
-    { "KEY_EJECTCD", 161 },
-    { "KEY_EJECTCLOSECD", 162 },
-    { "KEY_NEXTSONG", 163 },
-    { "KEY_PLAYPAUSE", 164 },
-    { "KEY_PREVIOUSSONG", 165 },
-    { "KEY_STOPCD", 166 },
-    { "KEY_RECORD", 167 },
-    { "KEY_REWIND", 168 },
-    { "KEY_PHONE", 169 },
-    { "KEY_ISO", 170 },
-    { "KEY_CONFIG", 171 },
-    { "KEY_HOMEPAGE", 172 },
-    { "KEY_REFRESH", 173 },
-    { "KEY_EXIT", 174 },
-    { "KEY_MOVE", 175 },
-    { "KEY_EDIT", 176 },
-    { "KEY_SCROLLUP", 177 },
-    { "KEY_SCROLLDOWN", 178 },
-    { "KEY_KPLEFTPAREN", 179 },
-    { "KEY_KPRIGHTPAREN", 180 },
-    { "KEY_NEW", 181 },
-    { "KEY_REDO", 182 },
-    { "KEY_F13", 183 },
-    { "KEY_F14", 184 },
-    { "KEY_F15", 185 },
-    { "KEY_F16", 186 },
-    { "KEY_F17", 187 },
-    { "KEY_F18", 188 },
-    { "KEY_F19", 189 },
-    { "KEY_F20", 190 },
-    { "KEY_F21", 191 },
-    { "KEY_F22", 192 },
-    { "KEY_F23", 193 },
-    { "KEY_F24", 194 },
-    { "KEY_PLAYCD", 200 },
-    { "KEY_PAUSECD", 201 },
-    { "KEY_PROG3", 202 },
-    { "KEY_PROG4", 203 },
-    { "KEY_DASHBOARD", 204 },
-    { "KEY_SUSPEND", 205 },
-    { "KEY_CLOSE", 206 },
-    { "KEY_PLAY", 207 },
-    { "KEY_FASTFORWARD", 208 },
-    { "KEY_BASSBOOST", 209 },
-    { "KEY_PRINT", 210 },
-    { "KEY_HP", 211 },
-    { "KEY_CAMERA", 212 },
-    { "KEY_SOUND", 213 },
-    { "KEY_QUESTION", 214 },
-    { "KEY_EMAIL", 215 },
-    { "KEY_CHAT", 216 },
-    { "KEY_SEARCH", 217 },
-    { "KEY_CONNECT", 218 },
-    { "KEY_FINANCE", 219 },
-    { "KEY_SPORT", 220 },
-    { "KEY_SHOP", 221 },
-    { "KEY_ALTERASE", 222 },
-    { "KEY_CANCEL", 223 },
-    { "KEY_BRIGHTNESSDOWN", 224 },
-    { "KEY_BRIGHTNESSUP", 225 },
-    { "KEY_MEDIA", 226 },
-    { "KEY_SWITCHVIDEOMODE", 227 },
-    { "KEY_KBDILLUMTOGGLE", 228 },
-    { "KEY_KBDILLUMDOWN", 229 },
-    { "KEY_KBDILLUMUP", 230 },
-    { "KEY_SEND", 231 },
-    { "KEY_REPLY", 232 },
-    { "KEY_FORWARDMAIL", 233 },
-    { "KEY_SAVE", 234 },
-    { "KEY_DOCUMENTS", 235 },
-    { "KEY_BATTERY", 236 },
-    { "KEY_BLUETOOTH", 237 },
-    { "KEY_WLAN", 238 },
-    { "KEY_UWB", 239 },
-    { "KEY_UNKNOWN", 240 },
-    { "KEY_VIDEO_NEXT", 241 },
-    { "KEY_VIDEO_PREV", 242 },
-    { "KEY_BRIGHTNESS_CYCLE", 243 },
-    { "KEY_BRIGHTNESS_AUTO", 244 },
-    { "KEY_DISPLAY_OFF", 245 },
-    { "KEY_WWAN", 246 },
-    { "KEY_RFKILL", 247 },
-    { "KEY_MICMUTE", 248 },
-    { "KEY_OK", 0x160 },
-    { "KEY_SELECT", 0 },
-    { "KEY_GOTO", 0 },
-    { "KEY_CLEAR", 0x163 },
-    { "KEY_POWER2", 356 },
-    { "KEY_OPTION", 0 },
-    { "KEY_INFO", 0 },
-    { "KEY_TIME", 0 },
-    { "KEY_VENDOR", 0 },
-    { "KEY_ARCHIVE", 0 },
-    { "KEY_PROGRAM", 0 },
-    { "KEY_CHANNEL", 0 },
-    { "KEY_FAVORITES", 0 },
-    { "KEY_EPG", 0x16d },
-    { "KEY_PVR", 0 },
-    { "KEY_MHP", 0 },
-    { "KEY_LANGUAGE", 0 },
-    { "KEY_TITLE", 0 },
-    { "KEY_SUBTITLE", 0x172 },
-    { "KEY_ANGLE", 0 },
-    { "KEY_FULL_SCREEN", 0 },
-    { "KEY_MODE", 0 },
-    { "KEY_KEYBOARD", 0 },
-    { "KEY_ASPECT_RATIO", 0 },
-    { "KEY_PC", 0 },
-    { "KEY_TV", 0 },
-    { "KEY_TV2", 0 },
-    { "KEY_VCR", 0 },
-    { "KEY_VCR2", 0 },
-    { "KEY_SAT", 0 },
-    { "KEY_SAT2", 0 },
-    { "KEY_CD", 0 },
-    { "KEY_TAPE", 0 },
-    { "KEY_RADIO", 0 },
-    { "KEY_TUNER", 0 },
-    { "KEY_PLAYER", 0 },
-    { "KEY_TEXT", 0 },
-    { "KEY_DVD", 0 },
-    { "KEY_AUX", 0 },
-    { "KEY_MP3", 0 },
-    { "KEY_AUDIO", 0x188 },
-    { "KEY_VIDEO", 0 },
-    { "KEY_DIRECTORY", 0 },
-    { "KEY_LIST", 0 },
-    { "KEY_MEMO", 0 },
-    { "KEY_CALENDAR", 0 },
-    { "KEY_RED", 0x18e },
-    { "KEY_GREEN", 0x18f },
-    { "KEY_YELLOW", 0x190 },
-    { "KEY_BLUE", 0x191 },
-    { "KEY_CHANNELUP", 0x192 },
-    { "KEY_CHANNELDOWN", 0x193 },
-    { "KEY_FIRST", 0 },
-    { "KEY_LAST", 0 },
-    { "KEY_AB", 0 },
-    { "KEY_NEXT", 0x197 },
-    { "KEY_RESTART", 0 },
-    { "KEY_SLOW", 0 },
-    { "KEY_SHUFFLE", 0 },
-    { "KEY_BREAK", 0 },
-    { "KEY_PREVIOUS", 0x19c },
-    { "KEY_DIGITS", 0 },
-    { "KEY_TEEN", 0 },
-    { "KEY_TWEN", 0 },
-    { "KEY_VIDEOPHONE", 0 },
-    { "KEY_GAMES", 0 },
-    { "KEY_ZOOMIN", 0 },
-    { "KEY_ZOOMOUT", 0 },
-    { "KEY_ZOOMRESET", 0 },
-    { "KEY_WORDPROCESSOR", 0 },
-    { "KEY_EDITOR", 0 },
-    { "KEY_SPREADSHEET", 0 },
-    { "KEY_GRAPHICSEDITOR", 0 },
-    { "KEY_PRESENTATION", 0 },
-    { "KEY_DATABASE", 0 },
-    { "KEY_NEWS", 0 },
-    { "KEY_VOICEMAIL", 0 },
-    { "KEY_ADDRESSBOOK", 0 },
-    { "KEY_MESSENGER", 0 },
-    { "KEY_DISPLAYTOGGLE", 0 },
-    { "KEY_SPELLCHECK", 0 },
-    { "KEY_LOGOFF", 0 },
-    { "KEY_DOLLAR", 0 },
-    { "KEY_EURO", 0 },
-    { "KEY_FRAMEBACK", 0 },
-    { "KEY_FRAMEFORWARD", 0 },
-    { "KEY_CONTEXT_MENU", 0 },
-    { "KEY_MEDIA_REPEAT", 0 },
-    { "KEY_10CHANNELSUP", 0 },
-    { "KEY_10CHANNELSDOWN", 0 },
-    { "KEY_IMAGES", 0 },
-    { "KEY_NOTIFICATION_CENTER", 0 },
-    { "KEY_PICKUP_PHONE", 0 },
-    { "KEY_HANGUP_PHONE", 0 },
-    { "KEY_DEL_EOL", 0 },
-    { "KEY_DEL_EOS", 0 },
-    { "KEY_INS_LINE", 0 },
-    { "KEY_DEL_LINE", 0 },
-    { "KEY_FN", 0 },
-    { "KEY_FN_ESC", 0 },
-    { "KEY_FN_F1", 0 },
-    { "KEY_FN_F2", 0 },
-    { "KEY_FN_F3", 0 },
-    { "KEY_FN_F4", 0 },
-    { "KEY_FN_F5", 0 },
-    { "KEY_FN_F6", 0 },
-    { "KEY_FN_F7", 0 },
-    { "KEY_FN_F8", 0 },
-    { "KEY_FN_F9", 0 },
-    { "KEY_FN_F10", 0 },
-    { "KEY_FN_F11", 0 },
-    { "KEY_FN_F12", 0 },
-    { "KEY_FN_1", 0 },
-    { "KEY_FN_2", 0 },
-    { "KEY_FN_D", 0 },
-    { "KEY_FN_E", 0 },
-    { "KEY_FN_F", 0 },
-    { "KEY_FN_S", 0 },
-    { "KEY_FN_B", 0 },
-    { "KEY_FN_RIGHT_SHIFT", 0 },
-    { "KEY_BRL_DOT1", 0 },
-    { "KEY_BRL_DOT2", 0 },
-    { "KEY_BRL_DOT3", 0 },
-    { "KEY_BRL_DOT4", 0 },
-    { "KEY_BRL_DOT5", 0 },
-    { "KEY_BRL_DOT6", 0 },
-    { "KEY_BRL_DOT7", 0 },
-    { "KEY_BRL_DOT8", 0 },
-    { "KEY_BRL_DOT9", 0 },
-    { "KEY_BRL_DOT10", 0 },
-    { "KEY_NUMERIC_0", 0x200 },
-    { "KEY_NUMERIC_1", 0x201 },
-    { "KEY_NUMERIC_2", 0x202 },
-    { "KEY_NUMERIC_3", 0x203 },
-    { "KEY_NUMERIC_4", 0x204 },
-    { "KEY_NUMERIC_5", 0x205 },
-    { "KEY_NUMERIC_6", 0x206 },
-    { "KEY_NUMERIC_7", 0x207 },
-    { "KEY_NUMERIC_8", 0x208 },
-    { "KEY_NUMERIC_9", 0x209 },
-    { "KEY_NUMERIC_STAR", 0 },
-    { "KEY_NUMERIC_POUND", 0 },
-    { "KEY_NUMERIC_A", 0 },
-    { "KEY_NUMERIC_B", 0 },
-    { "KEY_NUMERIC_C", 0 },
-    { "KEY_NUMERIC_D", 0 },
-    { "KEY_CAMERA_FOCUS", 0 },
-    { "KEY_WPS_BUTTON", 0 },
-    { "KEY_TOUCHPAD_TOGGLE", 0 },
-    { "KEY_TOUCHPAD_ON", 0 },
-    { "KEY_TOUCHPAD_OFF", 0 },
-    { "KEY_CAMERA_ZOOMIN", 0 },
-    { "KEY_CAMERA_ZOOMOUT", 0 },
-    { "KEY_CAMERA_UP", 0 },
-    { "KEY_CAMERA_DOWN", 0 },
-    { "KEY_CAMERA_LEFT", 0 },
-    { "KEY_CAMERA_RIGHT", 0 },
-    { "KEY_ATTENDANT_ON", 0 },
-    { "KEY_ATTENDANT_OFF", 0 },
-    { "KEY_ATTENDANT_TOGGLE", 0 },
-    { "KEY_LIGHTS_TOGGLE", 0 },
-    { "KEY_ALS_TOGGLE", 0 },
-    { "KEY_ROTATE_LOCK_TOGGLE", 0 },
-    { "KEY_BUTTONCONFIG", 0 },
-    { "KEY_TASKMANAGER", 0 },
-    { "KEY_JOURNAL", 0 },
-    { "KEY_CONTROLPANEL", 0 },
-    { "KEY_APPSELECT", 0 },
-    { "KEY_SCREENSAVER", 0 },
-    { "KEY_VOICECOMMAND", 0 },
-    { "KEY_ASSISTANT", 0 },
-    { "KEY_KBD_LAYOUT_NEXT", 0 },
-    { "KEY_EMOJI_PICKER", 0 },
-    { "KEY_BRIGHTNESS_MIN", 0 },
-    { "KEY_BRIGHTNESS_MAX", 0 },
-    { "KEY_KBDINPUTASSIST_PREV", 0 },
-    { "KEY_KBDINPUTASSIST_NEXT", 0 },
-    { "KEY_KBDINPUTASSIST_PREVGROUP", 0 },
-    { "KEY_KBDINPUTASSIST_NEXTGROUP", 0 },
-    { "KEY_KBDINPUTASSIST_ACCEPT", 0 },
-    { "KEY_KBDINPUTASSIST_CANCEL", 0 },
-    { "KEY_RIGHT_UP", 0 },
-    { "KEY_RIGHT_DOWN", 0 },
-    { "KEY_LEFT_UP", 0 },
-    { "KEY_LEFT_DOWN", 0 },
-    { "KEY_ROOT_MENU", 0 },
-    { "KEY_MEDIA_TOP_MENU", 0 },
-    { "KEY_NUMERIC_11", 0 },
-    { "KEY_NUMERIC_12", 0 },
-    { "KEY_AUDIO_DESC", 0 },
-    { "KEY_3D_MODE", 0 },
-    { "KEY_NEXT_FAVORITE", 0 },
-    { "KEY_STOP_RECORD", 0 },
-    { "KEY_PAUSE_RECORD", 0 },
-    { "KEY_VOD", 0 },
-    { "KEY_UNMUTE", 0 },
-    { "KEY_FASTREVERSE", 0 },
-    { "KEY_SLOWREVERSE", 0 },
-    { "KEY_DATA", 0 },
-    { "KEY_ONSCREEN_KEYBOARD", 0 },
-    { "KEY_PRIVACY_SCREEN_TOGGLE", 0 },
-    { "KEY_SELECTIVE_SCREENSHOT", 0 },
-    { "KEY_MACRO1", 0 },
-    { "KEY_MACRO2", 0 },
-    { "KEY_MACRO3", 0 },
-    { "KEY_MACRO4", 0 },
-    { "KEY_MACRO5", 0 },
-    { "KEY_MACRO6", 0 },
-    { "KEY_MACRO7", 0 },
-    { "KEY_MACRO8", 0 },
-    { "KEY_MACRO9", 0 },
-    { "KEY_MACRO10", 0 },
-    { "KEY_MACRO11", 0 },
-    { "KEY_MACRO12", 0 },
-    { "KEY_MACRO13", 0 },
-    { "KEY_MACRO14", 0 },
-    { "KEY_MACRO15", 0 },
-    { "KEY_MACRO16", 0 },
-    { "KEY_MACRO17", 0 },
-    { "KEY_MACRO18", 0 },
-    { "KEY_MACRO19", 0 },
-    { "KEY_MACRO20", 0 },
-    { "KEY_MACRO21", 0 },
-    { "KEY_MACRO22", 0 },
-    { "KEY_MACRO23", 0 },
-    { "KEY_MACRO24", 0 },
-    { "KEY_MACRO25", 0 },
-    { "KEY_MACRO26", 0 },
-    { "KEY_MACRO27", 0 },
-    { "KEY_MACRO28", 0 },
-    { "KEY_MACRO29", 0 },
-    { "KEY_MACRO30", 0 },
-    { "KEY_MACRO_RECORD_START", 0 },
-    { "KEY_MACRO_RECORD_STOP", 0 },
-    { "KEY_MACRO_PRESET_CYCLE", 0 },
-    { "KEY_MACRO_PRESET1", 0 },
-    { "KEY_MACRO_PRESET2", 0 },
-    { "KEY_MACRO_PRESET3", 0 },
-    { "KEY_KBD_LCD_MENU1", 0 },
-    { "KEY_KBD_LCD_MENU2", 0 },
-    { "KEY_KBD_LCD_MENU3", 0 },
-    { "KEY_KBD_LCD_MENU4", 0 },
-    { "KEY_KBD_LCD_MENU5", 0 },
-    { "KEY_MAX", 0 },
-    { "BTN_MOUSE", 0x110 },
-    { NULL, 0 }
-  };
-  for (int i = 0; table[i].name; i++) if (strcmp(name, table[i].name)==0) return table[i].code;
-  return -1;
+  const keycode_name_t *k = bsearch(name, keycode_names, sizeof(keycode_names) / sizeof(keycode_names[0]),
+    sizeof(keycode_names[0]), keycode_compare);
+  return k ? k->code : -1;
+}
+
+// Name for a keycode, "unknown" if it has none, so it can go straight into a printf
+const char *keycode_name(int code) {
+  const char *name = code > 0 && code <= KEYCODE_MAX ? keycode_by_code[code] : NULL;
+  return name ? name : "unknown";
 }
+
+#endif
@@ -0,0 +1,328 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "keymap.h"
+
+#define KEYMAP_MIN_SLOTS 64
+#define KEYMAP_EMPTY 1                                  // offset of "", bound but empty
+
+static uint32_t hash(uint8_t proto, uint32_t scancode) {
+    uint64_t key = (uint64_t)proto << 32 | scancode;
+    return (key * 0x9e3779b97f4a7c15ULL) >> 32;         // Fibonacci hashing, high bits mix best
+}
+
+// Slot holding the code, or the empty slot where it would go
+static uint32_t *probe(const keymap_t *map, uint8_t proto, uint32_t scancode) {
+    for (uint32_t i = hash(proto, scancode) & map->mask;; i = (i + 1) & map->mask) {
+        uint32_t *slot = &map->slot[i];
+        if (!*slot)
+            return slot;
+        const keymap_entry_t *e = &map->entry[*slot - 1];
+        if (e->scancode == scancode && e->proto == proto)
+            return slot;
+    }
+}
+
+static int rehash(keymap_t *map, uint32_t slots) {
+    uint32_t *slot = calloc(slots, sizeof(*slot));
+    if (!slot) {
+        perror("keymap index");
+        return -1;
+    }
+    free(map->slot);
+    map->slot = slot;
+    map->mask = slots - 1;
+    for (uint32_t i = 0; i < map->count; i++)
+        *probe(map, map->entry[i].proto, map->entry[i].scancode) = i + 1;
+    return 0;
+}
+
+int keymap_add(keymap_t *map, uint8_t proto, uint32_t scancode, uint16_t keycode, keymap_entry_t **key) {
+    *key = NULL;
+    if (map->mapped)
+        return -1;
+    if (map->count == map->size) {
+        uint32_t size = map->size ? 2 * map->size : KEYMAP_MIN_SLOTS / 2;
+        keymap_entry_t *entry = realloc(map->entry, size * sizeof(*entry));
+        if (!entry) {
+            perror("keymap entries");
+            return -1;
+        }
+        map->entry = entry;
+        map->size = size;
+    }
+    if (!map->slot || 2 * (map->count + 1) > map->mask + 1) {
+        if (rehash(map, map->slot ? 2 * (map->mask + 1) : KEYMAP_MIN_SLOTS) < 0)
+            return -1;
+    }
+
+    uint32_t *slot = probe(map, proto, scancode);
+    if (*slot)
+        return KEYMAP_DUPLICATE;                        // first entry for a code wins, as before
+    *key = &map->entry[map->count];
+    **key = (keymap_entry_t){ .scancode = scancode, .proto = proto, .keycode = keycode };
+    *slot = ++map->count;
+    return 0;
+}
+
+int keymap_set(keymap_t *map, keymap_entry_t *key, int act, const char *command) {
+    size_t len = strlen(command) + 1;
+
+    if (map->mapped || act < 0 || act >= ACT_COUNT)
+        return -1;
+    if (!map->strings_len)
+        map->strings_len = KEYMAP_EMPTY + 1;            // offset 0 unbound, 1 empty
+    if (map->strings_len + len > map->strings_size) {
+        uint32_t size = map->strings_size ? map->strings_size : 256;
+        while (map->strings_len + len > size) size *= 2;
+        char *strings = realloc(map->strings, size);
+        if (!strings) {
+            perror("keymap commands");
+            return -1;
+        }
+        if (!map->strings_size)
+            memset(strings, 0, KEYMAP_EMPTY + 1);
+        map->strings = strings;
+        map->strings_size = size;
+    }
+    if (len == 1) {
+        key->action[act] = KEYMAP_EMPTY;
+        return 0;
+    }
+    memcpy(map->strings + map->strings_len, command, len);
+    key->action[act] = map->strings_len;
+    map->strings_len += len;
+    return 0;
+}
+
+const keymap_entry_t *keymap_find(const keymap_t *map, uint8_t proto, uint32_t scancode) {
+    if (!map->slot)
+        return NULL;
+    uint32_t slot = *probe(map, proto, scancode);
+    return slot ? &map->entry[slot - 1] : NULL;
+}
+
+int keymap_merge(keymap_t *map, const keymap_t *from) {
+    int skipped = 0;
+
+    for (uint32_t i = 0; i < from->count; i++) {
+        const keymap_entry_t *e = &from->entry[i];
+        if (keymap_find(map, e->proto, e->scancode)) {
+            skipped++;                                  // earlier section wins, as within one
+            continue;
+        }
+        keymap_entry_t *key;
+        if (keymap_add(map, e->proto, e->scancode, e->keycode, &key) < 0)
+            return -1;
+        for (int a = 0; a < ACT_COUNT; a++) {
+            if (e->action[a] && keymap_set(map, key, a, from->strings + e->action[a]) < 0)
+                return -1;
+        }
+    }
+    return skipped;
+}
+
+void keymap_free(keymap_t *map) {
+    if (!map->mapped) {
+        free(map->entry);
+        free(map->slot);
+        free(map->strings);
+    }
+    *map = (keymap_t){0};
+}
+
+// Binary image: header, section table, then per section its entries, slots and strings,
+// each aligned to 8. Offsets are from the start of the file.
+
+static const char no_strings[KEYMAP_EMPTY + 1];         // a map with nothing but empty commands
+
+static uint32_t align8(uint32_t n) {
+    return (n + 7) & ~7u;
+}
+
+static int64_t mtime_ns(const struct stat *st) {
+    return st->st_mtim.tv_sec * 1000000000LL + st->st_mtim.tv_nsec;
+}
+
+// Zero padding up to offset, then len bytes
+static bool put(FILE *f, uint32_t *pos, uint32_t offset, const void *data, size_t len) {
+    static const uint8_t pad[8];
+    if (offset - *pos > sizeof(pad) || fwrite(pad, 1, offset - *pos, f) != offset - *pos)
+        return false;
+    *pos = offset + len;
+    return !len || fwrite(data, 1, len, f) == len;
+}
+
+int keymap_cache_write(const char *path, const struct stat *source, const char *const *names,
+    const keymap_t *maps, int count, const char *config) {
+    keymap_image_t head = {
+        .magic = KEYMAP_MAGIC, .version = KEYMAP_VERSION, .entry_size = sizeof(keymap_entry_t),
+        .sections = count, .source_mtime_ns = mtime_ns(source), .source_size = source->st_size,
+    };
+    keymap_section_t *table = calloc(count ? count : 1, sizeof(*table));
+    char tmp[256];
+    uint32_t off = align8(sizeof(head) + count * sizeof(*table)), pos = 0;
+
+    if (!table)
+        return -1;
+    for (int i = 0; i < count; i++) {
+        const keymap_t *m = &maps[i];
+        keymap_section_t *s = &table[i];
+        snprintf(s->name, sizeof(s->name), "%s", names[i]);
+        s->count = m->count;
+        s->slots = m->slot ? m->mask + 1 : 0;
+        s->strings_len = m->strings_len ? m->strings_len : sizeof(no_strings);
+        s->entry_offset = off;
+        off = align8(off + s->count * sizeof(keymap_entry_t));
+        s->slot_offset = off;
+        off = align8(off + s->slots * sizeof(uint32_t));
+        s->strings_offset = off;
+        off = align8(off + s->strings_len);
+    }
+    if (config) {
+        head.config_offset = off;
+        head.config_len = strlen(config) + 1;
+    }
+
+    // Written next to the final name and renamed over it, so a reader sees old or new
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *f = fopen(tmp, "wb");
+    if (!f) {
+        perror(tmp);
+        free(table);
+        return -1;
+    }
+    bool ok = put(f, &pos, 0, &head, sizeof(head)) && put(f, &pos, pos, table, count * sizeof(*table));
+    for (int i = 0; ok && i < count; i++) {
+        const keymap_t *m = &maps[i];
+        const keymap_section_t *s = &table[i];
+        ok = put(f, &pos, s->entry_offset, m->entry, s->count * sizeof(keymap_entry_t)) &&
+            put(f, &pos, s->slot_offset, m->slot, s->slots * sizeof(uint32_t)) &&
+            put(f, &pos, s->strings_offset, m->strings_len ? m->strings : no_strings, s->strings_len);
+    }
+    if (ok && config)
+        ok = put(f, &pos, head.config_offset, config, head.config_len);
+    free(table);
+    if (fclose(f) != 0 || !ok || rename(tmp, path) < 0) {
+        perror(path);
+        unlink(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+static bool inside(const keymap_cache_t *cache, uint32_t offset, uint64_t len) {
+    return offset <= cache->len && len <= cache->len - offset && !(offset & 7);
+}
+
+// Everything keymap_find() and keymap_command() will touch, so a damaged image is
+// rejected here instead of crashing a lookup
+static bool section_valid(const keymap_cache_t *cache, const keymap_section_t *s) {
+    if (!inside(cache, s->entry_offset, (uint64_t)s->count * sizeof(keymap_entry_t)) ||
+        !inside(cache, s->slot_offset, (uint64_t)s->slots * sizeof(uint32_t)) ||
+        !inside(cache, s->strings_offset, s->strings_len) ||
+        s->strings_len < sizeof(no_strings) || memchr(s->name, '\0', sizeof(s->name)) == NULL)
+        return false;
+    if (s->count && (s->slots < 2 * s->count || (s->slots & (s->slots - 1))))
+        return false;                                   // a full table would probe forever
+
+    const char *strings = (const char *)cache->base + s->strings_offset;
+    if (strings[s->strings_len - 1] || strings[0] || strings[KEYMAP_EMPTY])
+        return false;
+    const keymap_entry_t *entry = (const keymap_entry_t *)(cache->base + s->entry_offset);
+    for (uint32_t i = 0; i < s->count; i++) {
+        for (int a = 0; a < ACT_COUNT; a++) {
+            if (entry[i].action[a] >= s->strings_len)
+                return false;
+        }
+    }
+    const uint32_t *slot = (const uint32_t *)(cache->base + s->slot_offset);
+    uint32_t used = 0;
+    for (uint32_t i = 0; i < s->slots; i++) {
+        if (slot[i] > s->count)
+            return false;
+        if (slot[i])
+            used++;
+    }
+    return used <= s->count;                            // an empty slot is left to end every probe
+}
+
+int keymap_cache_open(const char *path, const struct stat *source, keymap_cache_t *cache) {
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+
+    *cache = (keymap_cache_t){0};
+    if (fd < 0)
+        return -1;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(keymap_image_t)) {
+        close(fd);
+        return -1;
+    }
+    void *base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        perror("mmap keymap cache");
+        return -1;
+    }
+    cache->base = base;
+    cache->len = st.st_size;
+
+    const keymap_image_t *head = base;
+    const char *why = NULL;
+    if (head->magic != KEYMAP_MAGIC || head->version != KEYMAP_VERSION || head->entry_size != sizeof(keymap_entry_t))
+        why = "other version";
+    else if (head->source_mtime_ns != mtime_ns(source) || head->source_size != (uint64_t)source->st_size)
+        why = "stale";
+    else if (!inside(cache, sizeof(*head), (uint64_t)head->sections * sizeof(keymap_section_t)) ||
+             (head->config_len && (!inside(cache, head->config_offset, head->config_len) ||
+                                   cache->base[head->config_offset + head->config_len - 1])))
+        why = "damaged";
+    const keymap_section_t *table = (const keymap_section_t *)(head + 1);
+    for (uint32_t i = 0; !why && i < head->sections; i++) {
+        if (!section_valid(cache, &table[i]))
+            why = "damaged";
+    }
+    if (why) {
+        fprintf(stderr, "Keymap cache %s is %s, using the JSON\n", path, why);
+        keymap_cache_close(cache);
+        return -1;
+    }
+    return 0;
+}
+
+bool keymap_cache_section(const keymap_cache_t *cache, const char *name, keymap_t *map) {
+    const keymap_image_t *head = (const keymap_image_t *)cache->base;
+    const keymap_section_t *table = (const keymap_section_t *)(head + 1);
+
+    for (uint32_t i = 0; i < head->sections; i++) {
+        const keymap_section_t *s = &table[i];
+        if (strcmp(s->name, name))
+            continue;
+        *map = (keymap_t){
+            .entry = (keymap_entry_t *)(cache->base + s->entry_offset),
+            .count = s->count, .size = s->count,
+            .slot = s->slots ? (uint32_t *)(cache->base + s->slot_offset) : NULL,
+            .mask = s->slots - 1,
+            .strings = (char *)(cache->base + s->strings_offset),
+            .strings_len = s->strings_len, .strings_size = s->strings_len,
+            .mapped = true,
+        };
+        return true;
+    }
+    return false;
+}
+
+const char *keymap_cache_config(const keymap_cache_t *cache) {
+    const keymap_image_t *head = (const keymap_image_t *)cache->base;
+    return head->config_len ? (const char *)cache->base + head->config_offset : NULL;
+}
+
+void keymap_cache_close(keymap_cache_t *cache) {
+    if (cache->base)
+        munmap((void *)cache->base, cache->len);
+    *cache = (keymap_cache_t){0};
+}
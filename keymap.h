@@ -0,0 +1,96 @@
+#ifndef KEYMAP_H
+#define KEYMAP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/stat.h>
+
+// Keymap sections as 1104-volumio looks them up, once per event. Entries are keyed by
+// (protocol, code) in an open addressing hash with linear probing, kept at most half
+// full, so a lookup is one or two probes whatever the size of the map. The entry found
+// holds the keycode and the command for every gesture, repeat policy included.
+// Entries grow as they are added, there is no fixed limit on keys per section.
+// Sections for different remotes merge into one map, told apart by protocol.
+//
+// Commands are offsets into the map's string pool rather than pointers, so a map is
+// three flat arrays. keymap_cache_write() stores every section of a keymap file that
+// way, keymap_cache_open() maps the image read-only and keymap_cache_section() points a
+// keymap_t straight into it: no parsing and no allocation per entry at startup.
+
+enum { ACT_PRESS, ACT_REPEAT, ACT_LONG, ACT_RELEASE, ACT_TAP2, ACT_TAP3, ACT_COUNT };
+
+typedef struct {
+    uint32_t scancode;                                  // IR scancode or button bits
+    uint8_t proto;                                      // IR_PROTO_*, IR_PROTO_NONE for buttons or any protocol
+    uint8_t reserved;
+    uint16_t keycode;
+    uint32_t action[ACT_COUNT];                         // command per gesture in strings, 0 if unbound
+} keymap_entry_t;
+
+typedef struct {
+    keymap_entry_t *entry;
+    uint32_t count, size;
+    uint32_t *slot;                                     // entry index + 1, 0 for an empty slot
+    uint32_t mask;                                      // slots - 1, a power of two
+    char *strings;                                      // NUL terminated commands, "" at offset 1
+    uint32_t strings_len, strings_size;
+    bool mapped;                                        // arrays belong to a keymap_cache_t
+} keymap_t;
+
+#define KEYMAP_DUPLICATE 1                              // keymap_add(): code already mapped, map unchanged
+
+// New entry with no actions in *key: 0, KEYMAP_DUPLICATE with *key NULL, or -1 if memory
+// ran out or the map is mapped. *key is valid until the next keymap_add().
+int keymap_add(keymap_t *map, uint8_t proto, uint32_t scancode, uint16_t keycode, keymap_entry_t **key);
+int keymap_set(keymap_t *map, keymap_entry_t *key, int act, const char *command);
+const keymap_entry_t *keymap_find(const keymap_t *map, uint8_t proto, uint32_t scancode);
+int keymap_merge(keymap_t *map, const keymap_t *from);  // codes already in map skipped and counted, -1 no memory
+void keymap_free(keymap_t *map);                        // entries, commands and index, unless mapped
+
+// Command bound to one gesture of a key, NULL if unbound or empty. An empty command
+// still counts as bound for keymap_bound(), it switches a default off.
+static inline bool keymap_bound(const keymap_entry_t *key, int act) {
+    return key && act >= 0 && act < ACT_COUNT && key->action[act];
+}
+
+static inline const char *keymap_command(const keymap_t *map, const keymap_entry_t *key, int act) {
+    if (!keymap_bound(key, act) || !map->strings[key->action[act]])
+        return 0;
+    return map->strings + key->action[act];
+}
+
+// Binary image
+
+#define KEYMAP_MAGIC    0x50414d4b                      // "KMAP"
+#define KEYMAP_VERSION  2                               // 2: entries keyed by protocol, merged section
+#define KEYMAP_NAME_MAX 32                              // section name with its NUL
+
+typedef struct {
+    uint32_t magic, version;
+    uint32_t entry_size;                                // sizeof(keymap_entry_t) of the writer
+    uint32_t sections;                                  // keymap_section_t follow the header
+    int64_t source_mtime_ns;                            // the JSON the image was compiled from
+    uint64_t source_size;
+    uint32_t config_offset, config_len;                 // "Config" as compact JSON text, NUL included
+} keymap_image_t;
+
+typedef struct {
+    char name[KEYMAP_NAME_MAX];
+    uint32_t count, slots;
+    uint32_t entry_offset, slot_offset, strings_offset, strings_len;
+} keymap_section_t;
+
+typedef struct {
+    const uint8_t *base;
+    size_t len;
+} keymap_cache_t;
+
+int keymap_cache_write(const char *path, const struct stat *source, const char *const *names,
+    const keymap_t *maps, int count, const char *config);
+int keymap_cache_open(const char *path, const struct stat *source, keymap_cache_t *cache);  // -1 missing, stale or bad
+bool keymap_cache_section(const keymap_cache_t *cache, const char *name, keymap_t *map);
+const char *keymap_cache_config(const keymap_cache_t *cache);  // NULL if the keymap had none
+void keymap_cache_close(keymap_cache_t *cache);
+
+#endif
@@ -0,0 +1,680 @@
+// gcc -Wall -Wextra -O2 -Isim -I. -o mcu-sim sim/mcu-sim.c I2C_target.c ir_decoder.c
+// ./mcu-sim [-d detents_per_s] [-r nec_repeats] [-b bounces] [-l host_latency_ms] [-k i2c_khz] [-t seconds]
+//           [-p sleep|stop|standby] [-w frames.txt] [-v]
+//
+// Runs the unmodified firmware against virtual peripherals, one step per CAPTURE_0 tick
+// (2 us), with a virtual Pi that reads frames the way 1104-volumio does.
+// Default scenario: an NEC key held for 20 repeats while the knob turns at 200 detents/s,
+// then a bouncing button press, a bouncing ADC keypad press and a two button chord.
+// Exits 1 if any event was lost on the way.
+// Time only passes in the firmware's __WFI(), under the power policy it chose: STANDBY
+// freezes CAPTURE_0, QEI, TIMER_0 and the ADC, and IR and QEI edges just wake the CPU.
+// -p sets gConfig.powerMax to compare the states.
+// -w writes each new frame the virtual Pi reads, in the format 1104-volumio -m replays.
+// ISR load comes from the firmware's own diag_t. SysTick advances a fixed number of
+// cycles per DriverLib call, so compare runs with each other, not with the chip.
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <setjmp.h>
+#include "ti_msp_dl_config.h"
+#undef main
+#include "i2c_regmap.h"
+#include "ir_decoder.h"
+
+#define TICK_HZ         500000                          // CAPTURE_0 clock, one simulation step
+#define CYCLES_PER_TICK (CPUCLK_FREQ / TICK_HZ)
+#define ISR_CYCLES      16                              // entry and exit
+#define CALL_CYCLES     12                              // per DriverLib call
+#define TIMER_0_TICKS   US(5000)                        // button scan
+#define TX_FIFO         4
+#define MAX_INPUTS      65536
+
+extern diag_t gDiag;
+extern mcu_config_t gConfig;
+void I2C_INST_IRQHandler(void);
+void GPIOA_IRQHandler(void);
+void QEI_0_INST_IRQHandler(void);
+void TIMER_0_INST_IRQHandler(void);
+void CAPTURE_0_INST_IRQHandler(void);
+void ADC12_0_INST_IRQHandler(void);
+int mcu_main(void);
+
+static void (*const handlers[SIM_IRQS])(void) = {
+    [I2C_INST_INT_IRQN] = I2C_INST_IRQHandler,
+    [GPIO_BUTTONS_INT_IRQN] = GPIOA_IRQHandler,
+    [QEI_0_INST_INT_IRQN] = QEI_0_INST_IRQHandler,
+    [TIMER_0_INST_INT_IRQN] = TIMER_0_INST_IRQHandler,
+    [CAPTURE_0_INST_INT_IRQN] = CAPTURE_0_INST_IRQHandler,
+    [ADC12_0_INST_INT_IRQN] = ADC12_0_INST_IRQHandler,
+};
+
+SysTick_Type sim_systick;
+static uint64_t now;                                    // ticks
+static uint64_t cycles;                                 // CPU cycles, drives SysTick
+static jmp_buf finish;
+static bool nvic[SIM_IRQS];
+static bool primask;                                    // __disable_irq(): WFI wakes, nothing dispatches
+static uint8_t policy = PWR_SLEEP;                      // set by DL_SYSCTL_setPowerPolicy*()
+static bool pin_wake;                                   // edge on a wake-up pin while in STANDBY
+static uint64_t end, frozen;                            // ticks
+
+typedef struct {
+    uint32_t count, cc[6];
+    uint32_t raw, enabled;
+    bool running;
+    int dir;
+} sim_timer_t;
+
+static sim_timer_t timers[SIM_GPIOA + 1];
+static uint64_t capture_start;                          // tick CAPTURE_0 started, stamps count from here
+
+static const uint32_t button_pins[] = {                // button n, as numbered by the firmware
+    GPIO_BUTTONS_BUTTON_1_PIN, GPIO_BUTTONS_BUTTON_2_PIN, GPIO_BUTTONS_BUTTON_3_PIN,
+    GPIO_BUTTONS_ROTARY_SWITCH_PIN,
+};
+
+static uint32_t gpio_out, gpio_oe, gpio_in = GPIO_BUTTONS_BUTTON_1_PIN | GPIO_BUTTONS_BUTTON_2_PIN |
+    GPIO_BUTTONS_BUTTON_3_PIN | GPIO_BUTTONS_ROTARY_SWITCH_PIN;
+static bool gpio_irq;                                   // falling edge latched, also while NVIC is off
+
+static struct {                                         // ladder pin, converted continuously
+    bool running;
+    uint16_t level, low, high;                          // no averaging: the level is the result
+    uint32_t raw, enabled;
+} adc = { .level = 0xfff, .high = 0xfff };
+
+static struct {
+    bool enabled;
+    uint8_t rx[8], rx_n;
+    uint8_t tx[TX_FIFO], tx_n;
+    uint8_t irq[16], irq_n;                             // pending IIDX in order
+} i2c;
+
+// Virtual Pi: falling edge on the IRQ line, then a status read and a frame read sized by it
+// until the status byte reports nothing
+enum { M_IDLE, M_WAIT, M_START, M_PTR, M_RESTART, M_READ, M_STOP };
+
+static struct {
+    int state;
+    uint64_t next;
+    uint8_t reg, buf[FRAME_SIZE];
+    int len, got;
+    bool edge, low;
+    uint32_t latency, byte;                             // ticks
+} m;
+
+enum { IN_IR, IN_DETENT, IN_BUTTON, IN_LADDER };
+
+#define BUTTON_PRESSED  0x100
+
+typedef struct {
+    uint64_t at;
+    uint8_t type;
+    int16_t arg;
+} input_t;
+
+static input_t inputs[MAX_INPUTS];
+static int n_inputs, next_input;
+
+static struct {
+    int ir_sent, ir_got, detents_sent, detents_got, buttons_sent, buttons_got, chords_sent, chords_got;
+    int mix_sent, mix_got, mix_released;                // NEC key pressed while a chord is held
+    uint32_t chord_releases, mixed;                     // mixed: scancode and buttons in one event
+    uint32_t frames, overflows, crc, seq_gaps, dups, nacks, regrown, gestures[8];
+    uint64_t bytes;
+    uint64_t latency_sum, latency_max, events;
+    int seq;
+    uint32_t ir_code, mix_code;
+    int verbose;
+} st = { .seq = -1, .ir_code = 0x000016, .mix_code = 0x000017 };
+
+static void cost(uint32_t n) {
+    cycles += n;
+    sim_systick.VAL = 0xffffff - (cycles & 0xffffff);
+}
+
+// DriverLib shim
+
+void SYSCFG_DL_init(void) {
+    timers[SIM_TIMER_0].enabled = DL_TIMER_INTERRUPT_ZERO_EVENT;
+    timers[SIM_QEI_0].enabled = DL_TIMER_INTERRUPT_ZERO_EVENT;
+    i2c.enabled = true;
+}
+
+static void step(void);
+static bool irq_pending(int irq);
+static void dispatch(void);
+
+void __WFI(void) {                                      // the simulation runs here, until an IRQ wakes the CPU
+    for (;;) {
+        for (int irq = 0; irq < SIM_IRQS; irq++)
+            if (nvic[irq] && irq_pending(irq)) pin_wake = true;
+        if (pin_wake) break;
+        step();
+    }
+    pin_wake = false;
+    cost(CALL_CYCLES);
+}
+
+void __disable_irq(void) { primask = true; }
+void __enable_irq(void) { primask = false; dispatch(); }
+
+void NVIC_EnableIRQ(int irq) { cost(CALL_CYCLES); nvic[irq] = true; }
+void NVIC_DisableIRQ(int irq) { cost(CALL_CYCLES); nvic[irq] = false; }
+void DL_Common_delayCycles(uint32_t n) { cost(n); }
+void DL_SYSCTL_setSYSOSCFreq(int freq) { (void)freq; cost(CALL_CYCLES); }
+void DL_SYSCTL_setPowerPolicyRUN0SLEEP0(void) { cost(CALL_CYCLES); policy = PWR_SLEEP; }
+void DL_SYSCTL_setPowerPolicySTOP0(void) { cost(CALL_CYCLES); policy = PWR_STOP; }
+void DL_SYSCTL_setPowerPolicySTANDBY0(void) { cost(CALL_CYCLES); policy = PWR_STANDBY; }
+
+void DL_ADC12_startConversion(sim_inst_t a) { (void)a; cost(CALL_CYCLES); }
+uint16_t DL_ADC12_getMemResult(sim_inst_t a, int idx) {     // 0 until the ladder runs: address 0x77
+    (void)a; (void)idx; cost(CALL_CYCLES);
+    return adc.running ? adc.level : 0;
+}
+void DL_ADC12_enableConversions(sim_inst_t a) { (void)a; cost(CALL_CYCLES); adc.running = true; }
+void DL_ADC12_disableConversions(sim_inst_t a) { (void)a; cost(CALL_CYCLES); adc.running = false; }
+void DL_ADC12_initSingleSample(sim_inst_t a, uint32_t repeat, uint32_t sampling, uint32_t trigger,
+    uint32_t resolution, uint32_t format) {
+    (void)a; (void)repeat; (void)sampling; (void)trigger; (void)resolution; (void)format; cost(CALL_CYCLES);
+}
+void DL_ADC12_setStartAddress(sim_inst_t a, uint32_t start) { (void)a; (void)start; cost(CALL_CYCLES); }
+void DL_ADC12_configWinCompLowThld(sim_inst_t a, uint16_t t) { (void)a; cost(CALL_CYCLES); adc.low = t; }
+void DL_ADC12_configWinCompHighThld(sim_inst_t a, uint16_t t) { (void)a; cost(CALL_CYCLES); adc.high = t; }
+void DL_ADC12_enableInterrupt(sim_inst_t a, uint32_t mask) { (void)a; cost(CALL_CYCLES); adc.enabled |= mask; }
+void DL_ADC12_clearInterruptStatus(sim_inst_t a, uint32_t mask) { (void)a; cost(CALL_CYCLES); adc.raw &= ~mask; }
+
+int DL_ADC12_getPendingInterrupt(sim_inst_t a) {
+    uint32_t pending = adc.raw & adc.enabled;
+
+    (void)a;
+    cost(CALL_CYCLES);
+    for (int iidx = DL_ADC12_IIDX_WINDOW_COMP_HIGH; iidx <= DL_ADC12_IIDX_WINDOW_COMP_LOW; iidx++) {
+        if (pending & (1u << (iidx - 1))) {
+            adc.raw &= ~(1u << (iidx - 1));
+            return iidx;
+        }
+    }
+    return DL_ADC12_IIDX_NO_INT;
+}
+
+void DL_GPIO_setPins(sim_inst_t port, uint32_t pins) { (void)port; cost(CALL_CYCLES); gpio_out |= pins; }
+void DL_GPIO_clearPins(sim_inst_t port, uint32_t pins) { (void)port; cost(CALL_CYCLES); gpio_out &= ~pins; }
+void DL_GPIO_togglePins(sim_inst_t port, uint32_t pins) { (void)port; cost(CALL_CYCLES); gpio_out ^= pins; }
+void DL_GPIO_enableOutput(sim_inst_t port, uint32_t pins) { (void)port; cost(CALL_CYCLES); gpio_oe |= pins; }
+void DL_GPIO_disableOutput(sim_inst_t port, uint32_t pins) { (void)port; cost(CALL_CYCLES); gpio_oe &= ~pins; }
+uint32_t DL_GPIO_readPins(sim_inst_t port, uint32_t pins) { (void)port; cost(CALL_CYCLES); return gpio_in & pins; }
+void DL_GPIO_clearInterruptStatus(sim_inst_t port, uint32_t pins) { (void)port; (void)pins; cost(CALL_CYCLES); gpio_irq = false; }
+void DL_GPIO_initPeripheralInputFunction(int pincm, int function) { (void)pincm; (void)function; cost(CALL_CYCLES); }
+void DL_GPIO_enableWakeUp(int pincm) { (void)pincm; cost(CALL_CYCLES); }
+
+static void i2c_raise(uint8_t iidx) {
+    for (int i = 0; i < i2c.irq_n; i++)
+        if (i2c.irq[i] == iidx && iidx == DL_I2C_IIDX_TARGET_TXFIFO_TRIGGER) return;
+    if (i2c.irq_n < sizeof(i2c.irq)) i2c.irq[i2c.irq_n++] = iidx;
+}
+
+void DL_I2C_setTargetOwnAddress(sim_inst_t inst, uint8_t address) { (void)inst; (void)address; cost(CALL_CYCLES); }
+void DL_I2C_enableTarget(sim_inst_t inst) { (void)inst; cost(CALL_CYCLES); i2c.enabled = true; }
+void DL_I2C_disableTarget(sim_inst_t inst) { (void)inst; cost(CALL_CYCLES); i2c.enabled = false; }
+bool DL_I2C_isTargetRXFIFOEmpty(sim_inst_t inst) { (void)inst; cost(CALL_CYCLES); return !i2c.rx_n; }
+void DL_I2C_flushTargetTXFIFO(sim_inst_t inst) { (void)inst; cost(CALL_CYCLES); i2c.tx_n = 0; }
+
+int DL_I2C_getPendingInterrupt(sim_inst_t inst) {
+    (void)inst;
+    cost(CALL_CYCLES);
+    if (!i2c.irq_n) return DL_I2C_IIDX_NO_INT;
+    uint8_t iidx = i2c.irq[0];
+    memmove(i2c.irq, i2c.irq + 1, --i2c.irq_n);
+    return iidx;
+}
+
+uint8_t DL_I2C_receiveTargetData(sim_inst_t inst) {
+    (void)inst;
+    cost(CALL_CYCLES);
+    if (!i2c.rx_n) return 0;
+    uint8_t byte = i2c.rx[0];
+    memmove(i2c.rx, i2c.rx + 1, --i2c.rx_n);
+    return byte;
+}
+
+uint8_t DL_I2C_fillTargetTXFIFO(sim_inst_t inst, const uint8_t *buf, uint8_t count) {
+    uint8_t n = 0;
+    (void)inst;
+    cost(CALL_CYCLES + count);
+    while (n < count && i2c.tx_n < TX_FIFO) i2c.tx[i2c.tx_n++] = buf[n++];
+    return n;
+}
+
+bool DL_I2C_transmitTargetDataCheck(sim_inst_t inst, uint8_t byte) {
+    (void)inst;
+    cost(CALL_CYCLES);
+    if (i2c.tx_n >= TX_FIFO) return false;
+    i2c.tx[i2c.tx_n++] = byte;
+    return true;
+}
+
+void DL_Timer_startCounter(sim_inst_t timer) {
+    cost(CALL_CYCLES);
+    timers[timer].running = true;
+    timers[timer].count = timer == SIM_CAPTURE_0 ? 0xffff : 0;
+    if (timer == SIM_CAPTURE_0) capture_start = now;
+}
+
+void DL_Timer_stopCounter(sim_inst_t timer) { cost(CALL_CYCLES); timers[timer].running = false; }
+uint32_t DL_Timer_getTimerCount(sim_inst_t timer) { cost(CALL_CYCLES); return timers[timer].count; }
+void DL_Timer_setCaptureCompareValue(sim_inst_t timer, uint32_t value, int index) { cost(CALL_CYCLES); timers[timer].cc[index] = value & 0xffff; }
+uint32_t DL_Timer_getCaptureCompareValue(sim_inst_t timer, int index) { cost(CALL_CYCLES); return timers[timer].cc[index]; }
+void DL_Timer_enableInterrupt(sim_inst_t timer, uint32_t mask) { cost(CALL_CYCLES); timers[timer].enabled |= mask; }
+void DL_Timer_disableInterrupt(sim_inst_t timer, uint32_t mask) { cost(CALL_CYCLES); timers[timer].enabled &= ~mask; }
+void DL_Timer_clearInterruptStatus(sim_inst_t timer, uint32_t mask) { cost(CALL_CYCLES); timers[timer].raw &= ~mask; }
+uint32_t DL_Timer_getRawInterruptStatus(sim_inst_t timer, uint32_t mask) { cost(CALL_CYCLES); return timers[timer].raw & mask; }
+uint32_t DL_Timer_getEnabledInterrupts(sim_inst_t timer, uint32_t mask) { cost(CALL_CYCLES); return timers[timer].enabled & mask; }
+int DL_Timer_getQEIDirection(sim_inst_t timer) { cost(CALL_CYCLES); return timers[timer].dir > 0; }
+
+int DL_Timer_getPendingInterrupt(sim_inst_t timer) {
+    uint32_t pending = timers[timer].raw & timers[timer].enabled;
+    cost(CALL_CYCLES);
+    if (!pending) return 0;
+    int bit = __builtin_ctz(pending);
+    timers[timer].raw &= ~(1u << bit);
+    return bit + 1;                                     // IIDX order follows the bit order
+}
+
+// Peripherals, one tick
+
+static void timer_tick(void) {
+    sim_timer_t *c = &timers[SIM_CAPTURE_0], *t = &timers[SIM_TIMER_0];
+
+    if (c->running) {
+        c->count = (c->count - 1) & 0xffff;             // ZERO seen after the reload: on the chip ISR
+        if (c->count == 0xffff) c->raw |= DL_TIMER_INTERRUPT_ZERO_EVENT;  // entry takes longer than a tick
+        for (int i = 1; i < 6; i++)
+            if (c->count == c->cc[i]) c->raw |= DL_TIMER_INTERRUPT_CC0_DN_EVENT << i;
+    }
+    if (t->running && ++t->count >= TIMER_0_TICKS) {
+        t->count = 0;
+        t->raw |= DL_TIMER_INTERRUPT_ZERO_EVENT;
+    }
+    if (adc.running) {                                  // window comparator, every conversion
+        if (adc.level > adc.high) adc.raw |= DL_ADC12_INTERRUPT_WINDOW_COMP_HIGH;
+        if (adc.level < adc.low) adc.raw |= DL_ADC12_INTERRUPT_WINDOW_COMP_LOW;
+    }
+}
+
+static bool irq_pending(int irq) {
+    switch (irq) {
+        case I2C_INST_INT_IRQN: return i2c.irq_n;
+        case GPIO_BUTTONS_INT_IRQN: return gpio_irq;
+        case QEI_0_INST_INT_IRQN: return timers[SIM_QEI_0].raw & timers[SIM_QEI_0].enabled;
+        case TIMER_0_INST_INT_IRQN: return timers[SIM_TIMER_0].raw & timers[SIM_TIMER_0].enabled;
+        case CAPTURE_0_INST_INT_IRQN: return timers[SIM_CAPTURE_0].raw & timers[SIM_CAPTURE_0].enabled;
+        case ADC12_0_INST_INT_IRQN: return adc.raw & adc.enabled;
+    }
+    return false;
+}
+
+static void dispatch(void) {                            // same priority: no nesting, lowest IRQn first
+    for (int guard = 0; !primask && guard < 256; guard++) {
+        int irq = 0;
+        while (irq < SIM_IRQS && !(nvic[irq] && irq_pending(irq))) irq++;
+        if (irq == SIM_IRQS) return;
+
+        if (cycles < now * CYCLES_PER_TICK) cycles = now * CYCLES_PER_TICK;
+        cost(ISR_CYCLES);
+        if (irq == GPIO_BUTTONS_INT_IRQN) gpio_irq = false;
+        if (irq == QEI_0_INST_INT_IRQN) timers[SIM_QEI_0].raw = 0;
+        if (irq == TIMER_0_INST_INT_IRQN) timers[SIM_TIMER_0].raw = 0;
+        handlers[irq]();
+    }
+    if (primask) return;
+    fprintf(stderr, "interrupt storm at %.3f s\n", (double)now / TICK_HZ);
+    exit(2);
+}
+
+static void apply_input(const input_t *in) {
+    sim_timer_t *c = &timers[SIM_CAPTURE_0];
+
+    switch (in->type) {
+        case IN_IR:                                     // falling edge, capture into CC0
+            if (policy == PWR_STANDBY) {                // CAPTURE_0 is stopped, the edge only wakes
+                pin_wake = true;
+                break;
+            }
+            c->cc[0] = c->count;
+            c->raw |= DL_TIMER_INTERRUPT_CC0_DN_EVENT;
+            break;
+        case IN_DETENT:
+            if (policy == PWR_STANDBY) {
+                pin_wake = true;
+                break;
+            }
+            timers[SIM_QEI_0].dir = in->arg;
+            timers[SIM_QEI_0].raw |= DL_TIMER_INTERRUPT_ZERO_EVENT;
+            break;
+        case IN_BUTTON: {                               // arg: button n, BUTTON_PRESSED while the pin is low
+            uint32_t pin = button_pins[in->arg & 3];
+            if ((in->arg & BUTTON_PRESSED) && (gpio_in & pin)) gpio_irq = true;
+            if (in->arg & BUTTON_PRESSED) gpio_in &= ~pin;
+            else gpio_in |= pin;
+            break;
+        }
+        case IN_LADDER:                                 // arg: level on the ladder pin
+            adc.level = in->arg;
+            break;
+    }
+}
+
+// Virtual Pi
+
+static FILE *frames_out;                                // -w
+
+static void master_frame(void) {
+    const uint8_t *f = m.buf;
+    int n = f[0] & STATUS_COUNT;
+
+    st.frames++;
+    st.bytes += m.len;
+    if (FRAME_LEN(n) > m.len) {                         // grew since the status read, stays queued
+        st.regrown++;
+        return;
+    }
+    if (crc8(f, FRAME_LEN(n) - 1) != f[FRAME_LEN(n) - 1]) {
+        st.crc++;
+        return;
+    }
+    if (st.seq >= 0 && f[2] == (uint8_t)st.seq) {
+        st.dups++;
+        return;
+    }
+    if (st.seq >= 0 && f[2] != (uint8_t)(st.seq + 1))
+        st.seq_gaps += (uint8_t)(f[2] - st.seq - 1);
+    st.seq = f[2];
+    if (frames_out) {
+        fprintf(frames_out, "%.3f", (double)now * 1000 / TICK_HZ);
+        for (int i = 0; i < FRAME_LEN(n); i++)
+            fprintf(frames_out, " %02x", f[i]);
+        fputc('\n', frames_out);
+    }
+    if (f[0] & STATUS_OVERFLOW) st.overflows++;
+    st.detents_got += (int8_t)f[1];
+
+    for (int i = 0; i < n; i++) {
+        const uint8_t *e = &f[FRAME_HDR + i * EVT_SIZE];
+        uint8_t gesture = EVT_GESTURE(e[0]);
+        uint32_t code = e[1] << 16 | e[2] << 8 | e[3];
+        uint32_t buttons = (uint32_t)e[4] << 24 | e[5] << 16 | e[6] << 8 | e[7];
+        uint32_t stamp = e[8] | e[9] << 8 | e[10] << 16 | (uint32_t)e[11] << 24;
+        uint64_t age = (uint32_t)(now - capture_start - stamp);
+
+        st.gestures[gesture & 7]++;
+        st.events++;
+        st.latency_sum += age;
+        if (age > st.latency_max) st.latency_max = age;
+        if (buttons && gesture == GESTURE_PRESS) st.buttons_got++;
+        if (buttons & (buttons - 1) && gesture == GESTURE_PRESS) st.chords_got++;
+        if (!buttons && EVT_PROTO(e) == IR_PROTO_NEC && code == st.ir_code &&
+            gesture >= GESTURE_PRESS && gesture <= GESTURE_LONG) st.ir_got++;
+        if (buttons & (buttons - 1) && gesture == GESTURE_RELEASE) st.chord_releases++;
+        if (buttons && code != 0xffffff) st.mixed++;
+        if (!buttons && EVT_PROTO(e) == IR_PROTO_NEC && code == st.mix_code) {
+            if (gesture == GESTURE_PRESS && EVT_COUNT(e[0]) == 1) st.mix_got++;
+            if (gesture == GESTURE_RELEASE) st.mix_released++;
+        }
+        if (st.verbose)
+            printf("%9.3f ms  gesture %d count %2d hold %5u ms  proto %d code 0x%06x buttons %08x  age %.3f ms\n",
+                (double)now * 1000 / TICK_HZ, gesture, EVT_COUNT(e[0]), EVT_HOLD(e), EVT_PROTO(e), code, buttons,
+                (double)age * 1000 / TICK_HZ);
+    }
+}
+
+static void master_begin(uint8_t reg, int len) {
+    m.reg = reg;
+    m.len = len;
+    m.state = M_START;
+    m.next = now;
+}
+
+static void master_tick(void) {
+    bool low = (gpio_oe & GPIO_LEDS_IRQ_PIN) && !(gpio_out & GPIO_LEDS_IRQ_PIN);
+
+    if (low && !m.low) m.edge = true;                   // gpiod queues the edge while we are busy
+    m.low = low;
+    if (m.state == M_IDLE) {
+        if (!m.edge) return;
+        m.edge = false;
+        m.state = M_WAIT;
+        m.next = now + m.latency;
+    }
+    if (now < m.next) return;
+
+    switch (m.state) {
+        case M_WAIT:
+            master_begin(REG_STATUS, 1);
+            break;
+        case M_START:
+            if (!i2c.enabled) {                         // SCL held by the wake pulse: NACK, try again
+                st.nacks++;
+                m.state = M_WAIT;
+                m.next = now + US(1000);
+                break;
+            }
+            i2c_raise(DL_I2C_IIDX_TARGET_START);
+            m.state = M_PTR;
+            m.next = now + 2 * m.byte;                  // address and pointer byte
+            break;
+        case M_PTR:
+            i2c.rx[i2c.rx_n++] = m.reg;
+            i2c_raise(DL_I2C_IIDX_TARGET_RXFIFO_TRIGGER);
+            m.state = M_RESTART;
+            m.next = now + 1;
+            break;
+        case M_RESTART:
+            i2c_raise(DL_I2C_IIDX_TARGET_START);
+            m.state = M_READ;
+            m.got = 0;
+            m.next = now + m.byte;                      // address
+            break;
+        case M_READ:
+            if (!i2c.tx_n) {                            // clock stretched until the target fills the FIFO
+                i2c_raise(DL_I2C_IIDX_TARGET_TXFIFO_TRIGGER);
+                break;
+            }
+            m.buf[m.got++] = i2c.tx[0];
+            memmove(i2c.tx, i2c.tx + 1, --i2c.tx_n);
+            if (!i2c.tx_n) i2c_raise(DL_I2C_IIDX_TARGET_TXFIFO_TRIGGER);
+            m.next = now + m.byte;
+            if (m.got == m.len) m.state = M_STOP;
+            break;
+        case M_STOP:
+            i2c_raise(DL_I2C_IIDX_TARGET_STOP);
+            if (m.reg == REG_FRAME) {
+                master_frame();
+                master_begin(REG_STATUS, 1);
+                m.next = now + m.byte;
+            } else if (m.buf[0] & (STATUS_COUNT | STATUS_QEI)) {
+                uint8_t n = m.buf[0] & STATUS_COUNT;
+                master_begin(REG_FRAME, FRAME_LEN(n < EVT_BURST ? n : EVT_BURST));
+                m.next = now + m.byte;
+            } else m.state = M_IDLE;
+            break;
+    }
+}
+
+// Scenario
+
+static void add_input(uint64_t at, uint8_t type, int16_t arg) {
+    if (n_inputs < MAX_INPUTS) inputs[n_inputs++] = (input_t){ at, type, arg };
+}
+
+static int input_order(const void *a, const void *b) {
+    const input_t *x = a, *y = b;
+    return x->at < y->at ? -1 : x->at > y->at;
+}
+
+static uint64_t nec_frame(uint64_t t, uint32_t data) {  // falling edges of one NEC frame
+    add_input(t, IN_IR, 0);
+    t += US(13500);
+    add_input(t, IN_IR, 0);
+    for (int i = 0; i < 32; i++) {
+        t += data & (1UL << i) ? US(2250) : US(1125);
+        add_input(t, IN_IR, 0);
+    }
+    return t;
+}
+
+static uint64_t button(uint64_t t, int n, int pressed, int bounces) {
+    int down = n | BUTTON_PRESSED;
+
+    for (int i = 0; i < bounces; i++, t += US(300))
+        add_input(t, IN_BUTTON, (i & 1) == !pressed ? down : n);
+    add_input(t, IN_BUTTON, pressed ? down : n);
+    return t;
+}
+
+static uint64_t ladder(uint64_t t, int level, int bounces) {  // contact bounce against the idle level
+    for (int i = 0; i < bounces; i++, t += US(300))
+        add_input(t, IN_LADDER, (i & 1) ? 0xfff : level);
+    add_input(t, IN_LADDER, level);
+    return t;
+}
+
+static void step(void) {                                // half a tick: peripherals, then the Pi
+    static bool half;
+
+    if (!half) {
+        if (now >= end) longjmp(finish, 1);
+        while (next_input < n_inputs && inputs[next_input].at <= now)
+            apply_input(&inputs[next_input++]);
+        if (policy != PWR_STANDBY) timer_tick();
+        else {
+            frozen++;
+            capture_start++;                            // keeps event stamps comparable with now
+        }
+    } else {
+        master_tick();
+        now++;
+    }
+    half = !half;
+}
+
+static void run(void) {                                 // firmware main(), never returns
+    if (!setjmp(finish))
+        mcu_main();
+}
+
+int main(int argc, char *argv[]) {
+    int detent_rate = 200, repeats = 20, bounces = 5, latency_ms = 1, khz = 100, opt;
+    double seconds = 0;                                 // default: one second past the last input
+
+    const char *power_names[PWR_STATES] = { "run", "sleep", "stop", "standby" };
+    int power = PWR_STOP;
+
+    while ((opt = getopt(argc, argv, "d:r:b:l:k:t:p:w:v")) != -1) {
+        switch (opt) {
+            case 'd': detent_rate = atoi(optarg); break;
+            case 'r': repeats = atoi(optarg); break;
+            case 'b': bounces = atoi(optarg); break;
+            case 'l': latency_ms = atoi(optarg); break;
+            case 'k': khz = atoi(optarg); break;
+            case 't': seconds = atof(optarg); break;
+            case 'p':
+                for (power = PWR_SLEEP; power < PWR_STATES && strcmp(optarg, power_names[power]); power++);
+                if (power == PWR_STATES) {
+                    fprintf(stderr, "power state is sleep, stop or standby\n");
+                    return 1;
+                }
+                break;
+            case 'w':
+                if (!(frames_out = fopen(optarg, "w"))) {
+                    perror(optarg);
+                    return 1;
+                }
+                break;
+            case 'v': st.verbose = 1; break;
+            default:
+                fprintf(stderr, "usage: %s [-d detents_per_s] [-r nec_repeats] [-b bounces] "
+                    "[-l host_latency_ms] [-k i2c_khz] [-t seconds] [-p sleep|stop|standby] [-w frames.txt] [-v]\n", argv[0]);
+                return 1;
+        }
+    }
+    m.latency = latency_ms * US(1000);
+    m.byte = khz > 0 ? 9 * TICK_HZ / (khz * 1000) : 45;
+    if (!m.byte) m.byte = 1;
+
+    // NEC address 0x00 command 0x16, then repeat codes every 108 ms
+    uint64_t t = US(100000), burst = t;
+    uint32_t nec = 0x00 | 0xff << 8 | 0x16 << 16 | (uint32_t)0xe9 << 24;
+    nec_frame(t, nec);
+    st.ir_sent = 1 + repeats;
+    for (int i = 1; i <= repeats; i++) {
+        add_input(t + i * US(108000), IN_IR, 0);
+        add_input(t + i * US(108000) + US(11250), IN_IR, 0);
+    }
+    uint64_t burst_end = t + (repeats + 1) * US(108000);
+    for (t = burst; detent_rate > 0 && t < burst_end; t += TICK_HZ / detent_rate) {
+        add_input(t, IN_DETENT, 1);
+        st.detents_sent++;
+    }
+    t = button(burst_end + US(300000), 3, 1, bounces);  // rotary switch
+    t = button(t + US(300000), 3, 0, bounces);
+    t = ladder(t + US(300000), 1024, bounces);          // ladder key 2
+    t = ladder(t + US(300000), 0xfff, bounces);
+    t = button(t + US(600000), 0, 1, bounces);          // button 0 and the rotary switch, 15 ms apart
+    button(t + US(15000), 3, 1, bounces);
+    nec_frame(t + US(150000), 0x00 | 0xff << 8 | 0x17 << 16 | (uint32_t)0xe8 << 24);   // remote while held
+    st.mix_sent = 1;
+    t = button(t + US(400000), 0, 0, bounces);
+    t = button(t + US(10000), 3, 0, bounces);
+    if (seconds <= 0) seconds = (double)(t + US(1000000)) / TICK_HZ;
+    st.buttons_sent = 3;
+    st.chords_sent = 1;
+    qsort(inputs, n_inputs, sizeof(inputs[0]), input_order);
+
+    end = seconds * TICK_HZ;
+    gConfig.powerMax = power;
+    run();
+
+    const char *isr_names[DIAG_ISRS] = { "I2C", "CAPTURE_0", "TIMER_0", "GPIO/ADC", "QEI_0" };
+    double total = (double)end * CYCLES_PER_TICK;
+    int lost = (st.ir_sent - st.ir_got) + (st.detents_sent - st.detents_got) + (st.buttons_sent - st.buttons_got) +
+        (st.chords_sent - st.chords_got) + (st.mix_sent - st.mix_got) + (st.mix_sent - st.mix_released) +
+        st.mixed + (st.chord_releases != (uint32_t)st.chords_sent);
+
+    printf("%.1f s, %d detents/s, %d NEC repeats, host latency %d ms, I2C %d kHz, down to %s\n",
+        seconds, detent_rate, repeats, latency_ms, khz, power_names[power]);
+    printf("IR frames %d/%d, detents %d/%d, button presses %d/%d, chords %d/%d\n",
+        st.ir_got, st.ir_sent, st.detents_got, st.detents_sent, st.buttons_got, st.buttons_sent,
+        st.chords_got, st.chords_sent);
+    printf("IR during a chord %d/%d, released %d, chord releases %u, events mixing IR and buttons %u\n",
+        st.mix_got, st.mix_sent, st.mix_released, st.chord_releases, st.mixed);
+    printf("I2C frames %u, overflow %u, CRC errors %u, sequence gaps %u, duplicates %u, NACKs %u\n",
+        st.frames, st.overflows, st.crc, st.seq_gaps, st.dups, st.nacks);
+    printf("frame bytes %llu, %.1f per frame, %u read again after growing\n", (unsigned long long)st.bytes,
+        st.frames ? (double)st.bytes / st.frames : 0, st.regrown);
+    printf("gestures: press %u repeat %u long %u release %u tap %u\n", st.gestures[GESTURE_PRESS],
+        st.gestures[GESTURE_REPEAT], st.gestures[GESTURE_LONG], st.gestures[GESTURE_RELEASE], st.gestures[GESTURE_TAP]);
+    if (st.events)
+        printf("event age at read: avg %.2f ms, max %.2f ms\n",
+            (double)st.latency_sum / st.events * 1000 / TICK_HZ, (double)st.latency_max * 1000 / TICK_HZ);
+    printf("%-10s %10s %10s %10s %8s\n", "ISR", "entries", "avg cyc", "max cyc", "load %");
+    for (int i = 0; i < DIAG_ISRS; i++) {
+        const diag_isr_t *d = &gDiag.isr[i];
+        printf("%-10s %10u %10.1f %10u %8.3f\n", isr_names[i], d->count,
+            d->count ? (double)d->cycles / d->count : 0, d->max, 100 * d->cycles / total);
+    }
+    printf("IR rejects:");
+    for (int p = 0; p < IR_PROTO_COUNT; p++)
+        printf(" %u", gDiag.irFail[p]);
+    printf(", wake pulses %u\n", gDiag.wakePulses);
+    printf("%-10s %10s %10s\n", "state", "time %", "wake us");
+    for (int i = 0; i < PWR_STATES; i++)                // STANDBY time is what CAPTURE_0 missed
+        printf("%-10s %10.2f %10u\n", power_names[i],
+            100.0 * (i == PWR_STANDBY ? frozen : gDiag.stateTicks[i]) / end, gDiag.wakeMax[i] * 2);
+    if (frames_out) fclose(frames_out);
+    return lost || st.crc ? 1 : 0;
+}
@@ -0,0 +1,192 @@
+#ifndef TI_MSP_DL_CONFIG_H
+#define TI_MSP_DL_CONFIG_H
+
+// DriverLib shim for mcu-sim: just the parts of ti_msp_dl_config.h and DriverLib that
+// I2C_target.c uses, backed by the virtual peripherals in mcu-sim.c.
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define main            mcu_main                        // mcu-sim.c owns main()
+
+#define CPUCLK_FREQ     4000000
+
+typedef enum {
+    SIM_I2C,
+    SIM_ADC12_0,
+    SIM_CAPTURE_0,
+    SIM_QEI_0,
+    SIM_TIMER_0,
+    SIM_GPIOA,
+} sim_inst_t;
+
+#define I2C_INST                        SIM_I2C
+#define ADC12_0_INST                    SIM_ADC12_0
+#define ADC12_0_ADCMEM_LADDER           DL_ADC12_MEM_IDX_1
+#define CAPTURE_0_INST                  SIM_CAPTURE_0
+#define QEI_0_INST                      SIM_QEI_0
+#define TIMER_0_INST                    SIM_TIMER_0
+#define GPIOA                           SIM_GPIOA
+
+enum {                                                  // also the dispatch order of same priority IRQs
+    I2C_INST_INT_IRQN,
+    GPIO_BUTTONS_INT_IRQN,
+    QEI_0_INST_INT_IRQN,
+    TIMER_0_INST_INT_IRQN,
+    CAPTURE_0_INST_INT_IRQN,
+    ADC12_0_INST_INT_IRQN,
+    SIM_IRQS,
+};
+
+#define GPIO_LEDS_PORT                  GPIOA
+#define GPIO_LEDS_USER_LED_1_PIN        (1u << 0)
+#define GPIO_LEDS_IRQ_PIN               (1u << 4)       // open drain to the Pi's GPIO4
+#define GPIO_BUTTONS_PORT               GPIOA
+#define GPIO_BUTTONS_ROTARY_SWITCH_PIN  (1u << 11)      // low while pressed
+#define GPIO_BUTTONS_BUTTON_1_PIN       (1u << 16)
+#define GPIO_BUTTONS_BUTTON_2_PIN       (1u << 17)
+#define GPIO_BUTTONS_BUTTON_3_PIN       (1u << 23)
+#define DL_GPIO_PIN_1                   (1u << 1)       // SCL
+
+#define IOMUX_PINCM2                    1
+#define IOMUX_PINCM2_PF_GPIOA_DIO01     1
+#define IOMUX_PINCM2_PF_I2C0_SCL        2
+#define GPIO_CAPTURE_0_C0_IOMUX         IOMUX_PINCM3
+#define GPIO_QEI_0_PHA_IOMUX            IOMUX_PINCM4
+#define GPIO_QEI_0_PHB_IOMUX            IOMUX_PINCM5
+#define GPIO_BUTTONS_ROTARY_SWITCH_IOMUX IOMUX_PINCM12
+#define GPIO_BUTTONS_BUTTON_1_IOMUX     IOMUX_PINCM17
+#define GPIO_BUTTONS_BUTTON_2_IOMUX     IOMUX_PINCM18
+#define GPIO_BUTTONS_BUTTON_3_IOMUX     IOMUX_PINCM24
+#define IOMUX_PINCM3                    3
+#define IOMUX_PINCM4                    4
+#define IOMUX_PINCM5                    5
+#define IOMUX_PINCM12                   12
+#define IOMUX_PINCM17                   17
+#define IOMUX_PINCM18                   18
+#define IOMUX_PINCM24                   24
+
+enum {
+    DL_I2C_IIDX_NO_INT,
+    DL_I2C_IIDX_TARGET_START,
+    DL_I2C_IIDX_TARGET_RXFIFO_TRIGGER,
+    DL_I2C_IIDX_TARGET_TXFIFO_TRIGGER,
+    DL_I2C_IIDX_TARGET_STOP,
+};
+
+enum {                                                  // lowest pending index is served first
+    DL_TIMER_IIDX_ZERO = 1,
+    DL_TIMER_IIDX_LOAD,
+    DL_TIMER_IIDX_CC0_DN,
+    DL_TIMER_IIDX_CC1_DN,
+    DL_TIMER_IIDX_CC2_DN,
+    DL_TIMER_IIDX_CC3_DN,
+    DL_TIMER_IIDX_CC4_DN,
+    DL_TIMER_IIDX_CC5_DN,
+};
+
+#define DL_TIMER_INTERRUPT_ZERO_EVENT   (1u << 0)
+#define DL_TIMER_INTERRUPT_LOAD_EVENT   (1u << 1)
+#define DL_TIMER_INTERRUPT_CC0_DN_EVENT (1u << 2)
+#define DL_TIMER_INTERRUPT_CC1_DN_EVENT (1u << 3)
+#define DL_TIMER_INTERRUPT_CC2_DN_EVENT (1u << 4)
+#define DL_TIMER_INTERRUPT_CC3_DN_EVENT (1u << 5)
+#define DL_TIMER_INTERRUPT_CC4_DN_EVENT (1u << 6)
+#define DL_TIMER_INTERRUPT_CC5_DN_EVENT (1u << 7)
+
+#define DL_TIMER_CC_0_INDEX             0
+#define DL_TIMER_CC_1_INDEX             1
+#define DL_TIMER_CC_2_INDEX             2
+#define DL_TIMER_CC_3_INDEX             3
+#define DL_TIMER_CC_4_INDEX             4
+#define DL_TIMER_CC_5_INDEX             5
+
+#define DL_ADC12_MEM_IDX_0              0
+#define DL_ADC12_MEM_IDX_1              1
+#define DL_ADC12_SEQ_START_ADDR_01      1
+#define DL_ADC12_REPEAT_MODE_ENABLED    1
+#define DL_ADC12_SAMPLING_SOURCE_AUTO   0
+#define DL_ADC12_TRIG_SRC_SOFTWARE      0
+#define DL_ADC12_SAMP_CONV_RES_12_BIT   0
+#define DL_ADC12_SAMP_CONV_DATA_FORMAT_UNSIGNED 0
+
+enum {
+    DL_ADC12_IIDX_NO_INT,
+    DL_ADC12_IIDX_OVERFLOW,
+    DL_ADC12_IIDX_TRIG_OVERFLOW,
+    DL_ADC12_IIDX_WINDOW_COMP_HIGH,
+    DL_ADC12_IIDX_WINDOW_COMP_LOW,
+};
+
+#define DL_ADC12_INTERRUPT_WINDOW_COMP_HIGH (1u << 2)
+#define DL_ADC12_INTERRUPT_WINDOW_COMP_LOW  (1u << 3)
+#define DL_SYSCTL_SYSOSC_FREQ_4M        1
+
+typedef struct {
+    volatile uint32_t CTRL, LOAD, VAL, CALIB;
+} SysTick_Type;
+
+extern SysTick_Type sim_systick;
+#define SysTick                         (&sim_systick)
+#define SysTick_CTRL_ENABLE_Msk         (1u << 0)
+#define SysTick_CTRL_CLKSOURCE_Msk      (1u << 2)
+
+void SYSCFG_DL_init(void);
+void __WFI(void);
+void __disable_irq(void);
+void __enable_irq(void);
+void NVIC_EnableIRQ(int irq);
+void NVIC_DisableIRQ(int irq);
+void DL_Common_delayCycles(uint32_t cycles);
+void DL_SYSCTL_setSYSOSCFreq(int freq);
+void DL_SYSCTL_setPowerPolicyRUN0SLEEP0(void);
+void DL_SYSCTL_setPowerPolicySTOP0(void);
+void DL_SYSCTL_setPowerPolicySTANDBY0(void);
+
+void DL_ADC12_startConversion(sim_inst_t adc);
+uint16_t DL_ADC12_getMemResult(sim_inst_t adc, int idx);
+void DL_ADC12_enableConversions(sim_inst_t adc);
+void DL_ADC12_disableConversions(sim_inst_t adc);
+void DL_ADC12_initSingleSample(sim_inst_t adc, uint32_t repeat, uint32_t sampling, uint32_t trigger,
+    uint32_t resolution, uint32_t format);
+void DL_ADC12_setStartAddress(sim_inst_t adc, uint32_t start);
+void DL_ADC12_configWinCompLowThld(sim_inst_t adc, uint16_t threshold);
+void DL_ADC12_configWinCompHighThld(sim_inst_t adc, uint16_t threshold);
+void DL_ADC12_enableInterrupt(sim_inst_t adc, uint32_t mask);
+void DL_ADC12_clearInterruptStatus(sim_inst_t adc, uint32_t mask);
+int DL_ADC12_getPendingInterrupt(sim_inst_t adc);
+
+void DL_GPIO_setPins(sim_inst_t port, uint32_t pins);
+void DL_GPIO_clearPins(sim_inst_t port, uint32_t pins);
+void DL_GPIO_togglePins(sim_inst_t port, uint32_t pins);
+void DL_GPIO_enableOutput(sim_inst_t port, uint32_t pins);
+void DL_GPIO_disableOutput(sim_inst_t port, uint32_t pins);
+uint32_t DL_GPIO_readPins(sim_inst_t port, uint32_t pins);
+void DL_GPIO_clearInterruptStatus(sim_inst_t port, uint32_t pins);
+void DL_GPIO_initPeripheralInputFunction(int pincm, int function);
+void DL_GPIO_enableWakeUp(int pincm);
+
+void DL_I2C_setTargetOwnAddress(sim_inst_t i2c, uint8_t address);
+int DL_I2C_getPendingInterrupt(sim_inst_t i2c);
+void DL_I2C_enableTarget(sim_inst_t i2c);
+void DL_I2C_disableTarget(sim_inst_t i2c);
+bool DL_I2C_isTargetRXFIFOEmpty(sim_inst_t i2c);
+uint8_t DL_I2C_receiveTargetData(sim_inst_t i2c);
+void DL_I2C_flushTargetTXFIFO(sim_inst_t i2c);
+uint8_t DL_I2C_fillTargetTXFIFO(sim_inst_t i2c, const uint8_t *buf, uint8_t count);
+bool DL_I2C_transmitTargetDataCheck(sim_inst_t i2c, uint8_t byte);
+
+void DL_Timer_startCounter(sim_inst_t timer);
+void DL_Timer_stopCounter(sim_inst_t timer);
+uint32_t DL_Timer_getTimerCount(sim_inst_t timer);
+void DL_Timer_setCaptureCompareValue(sim_inst_t timer, uint32_t value, int index);
+uint32_t DL_Timer_getCaptureCompareValue(sim_inst_t timer, int index);
+void DL_Timer_enableInterrupt(sim_inst_t timer, uint32_t mask);
+void DL_Timer_disableInterrupt(sim_inst_t timer, uint32_t mask);
+void DL_Timer_clearInterruptStatus(sim_inst_t timer, uint32_t mask);
+uint32_t DL_Timer_getRawInterruptStatus(sim_inst_t timer, uint32_t mask);
+uint32_t DL_Timer_getEnabledInterrupts(sim_inst_t timer, uint32_t mask);
+int DL_Timer_getPendingInterrupt(sim_inst_t timer);
+int DL_Timer_getQEIDirection(sim_inst_t timer);
+
+#endif
@@ -0,0 +1,14 @@
+#!/usr/bin/bash
+# Replays every fixture through ir_decoder.c, as recorded and with 60 us of
+# extra jitter on top of the jittered frames, and fails on any wrong or missed scancode.
+
+cd "$(dirname "$0")" || exit 1
+gcc -Wall -Wextra -O2 -o /tmp/ir-replay ../ir-replay.c ../ir_decoder.c || exit 1
+
+status=0
+for trace in *.txt; do
+    /tmp/ir-replay -c -q "$trace" > /dev/null || status=1
+    /tmp/ir-replay -c -q -j 60 -l 50 "$trace" > /dev/null || status=1
+done
+[ $status -eq 0 ] && echo "all traces decoded"
+exit $status
@@ -0,0 +1,104 @@
+#include <stdio.h>
+#include <string.h>
+#include <curl/curl.h>
+#include "volumio_http.h"
+
+#define HTTP_TIMEOUT_MS         2000
+#define HTTP_CONNECT_MS         500                     // Volumio is local, anything longer is down
+#define HTTP_KEEPIDLE_S         30                      // TCP keep-alive probes on the idle connection
+
+const char *volumio_url = VOLUMIO_URL;
+
+static CURL *http;
+
+typedef struct {
+    char *data;
+    size_t size, len;
+} body_t;
+
+static size_t collect_body(char *ptr, size_t size, size_t nmemb, void *userdata) {
+    body_t *body = userdata;
+    size_t n = size * nmemb;
+    if (!body)
+        return n;                                       // command replies are dropped
+    if (n > body->size - 1 - body->len)
+        n = body->size - 1 - body->len;
+    memcpy(body->data + body->len, ptr, n);
+    body->len += n;
+    body->data[body->len] = '\0';
+    return size * nmemb;
+}
+
+static CURL *http_handle(void) {
+    if (http)
+        return http;
+    http = curl_easy_init();
+    if (!http) {
+        fprintf(stderr, "curl_easy_init failed\n");
+        return NULL;
+    }
+    curl_easy_setopt(http, CURLOPT_TCP_NODELAY, 1L);   // requests are one small segment each
+    curl_easy_setopt(http, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(http, CURLOPT_TCP_KEEPIDLE, (long)HTTP_KEEPIDLE_S);
+    curl_easy_setopt(http, CURLOPT_TCP_KEEPINTVL, (long)HTTP_KEEPIDLE_S);
+    curl_easy_setopt(http, CURLOPT_TIMEOUT_MS, (long)HTTP_TIMEOUT_MS);
+    curl_easy_setopt(http, CURLOPT_CONNECTTIMEOUT_MS, (long)HTTP_CONNECT_MS);
+    curl_easy_setopt(http, CURLOPT_NOSIGNAL, 1L);       // timeouts without SIGALRM
+    curl_easy_setopt(http, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(http, CURLOPT_WRITEFUNCTION, collect_body);
+    curl_easy_setopt(http, CURLOPT_VERBOSE, 0L);
+    return http;
+}
+
+void volumio_close(void) {
+    if (http)
+        curl_easy_cleanup(http);
+    http = NULL;
+}
+
+// Volumio closed the kept connection under us: worth one retry on a new one.
+// Anything else (refused, timed out) would fail again, the next command reconnects.
+static int stale_connection(CURLcode res) {
+    return res == CURLE_SEND_ERROR || res == CURLE_RECV_ERROR || res == CURLE_GOT_NOTHING;
+}
+
+static int http_request(const char *url, int head, body_t *body) {
+    CURLcode res = CURLE_FAILED_INIT;
+
+    for (int attempt = 0; attempt < 2; attempt++) {
+        CURL *curl = http_handle();
+        if (!curl)
+            return -1;
+        curl_easy_setopt(curl, CURLOPT_URL, url);
+        if (head) curl_easy_setopt(curl, CURLOPT_NOBODY, 1L);    // we don't need body
+        else curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, body);
+        if (body) body->len = 0;
+
+        res = curl_easy_perform(curl);
+        if (res == CURLE_OK)
+            return 0;
+        volumio_close();
+        if (!stale_connection(res))
+            break;
+    }
+    fprintf(stderr, "curl error: %s\n", curl_easy_strerror(res));
+    return -1;
+}
+
+int volumio_command(const char *cmd) {
+    char url[256];
+    snprintf(url, sizeof(url), "%s/api/v1/commands/?cmd=%s", volumio_url, cmd);
+    return http_request(url, 1, NULL);
+}
+
+int volumio_get(const char *path, char *buf, size_t size) {
+    char url[256];
+    body_t body = { buf, size, 0 };
+
+    if (!size)
+        return -1;
+    buf[0] = '\0';
+    snprintf(url, sizeof(url), "%s%s", volumio_url, path);
+    return http_request(url, 0, &body) < 0 ? -1 : (int)body.len;
+}
@@ -0,0 +1,20 @@
+#ifndef VOLUMIO_HTTP_H
+#define VOLUMIO_HTTP_H
+
+#include <stddef.h>
+
+// Keep-alive client for the Volumio REST API, shared by 1104-volumio and http-bench.
+// One curl easy handle lives as long as the process, so its connection to Volumio stays
+// open and a command costs one request round trip instead of a TCP handshake as well.
+// A request that fails on a stale connection is retried once on a fresh handle.
+// Not thread safe: call from one thread only.
+
+#define VOLUMIO_URL     "http://localhost:3000"
+
+extern const char *volumio_url;                         // base URL, VOLUMIO_URL unless changed
+
+int volumio_command(const char *cmd);                   // /api/v1/commands/?cmd=..., 0 or -1
+int volumio_get(const char *path, char *buf, size_t size);  // body into buf, length or -1
+void volumio_close(void);                               // drop the handle and its connection
+
+#endif